@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "average.h"
+
+
+//init averaging structure for window of window_size values, returns 0 on success
+int init_average(average_data_t *avg, int window_size){
+        memset(avg, 0, sizeof(average_data_t));
+        avg->window_size = window_size;
+        avg->min_value = INT_MAX;
+        avg->max_value = INT_MIN;
+        avg->min_value_filtered = INT_MAX;
+        avg->max_value_filtered = INT_MIN;
+
+        avg->buffer = malloc(sizeof(int)*window_size);
+        avg->low = malloc(sizeof(int)*window_size);
+        avg->high = malloc(sizeof(int)*window_size);
+        avg->heap_pos = malloc(sizeof(int)*window_size);
+        if(avg->buffer==NULL || avg->low==NULL || avg->high==NULL || avg->heap_pos==NULL){
+                free_average(avg);
+                return 1;
+        }
+        return 0;
+}
+
+
+//release window buffers
+void free_average(average_data_t *avg){
+        free(avg->buffer);
+        free(avg->low);
+        free(avg->high);
+        free(avg->heap_pos);
+        avg->buffer = NULL;
+        avg->low = NULL;
+        avg->high = NULL;
+        avg->heap_pos = NULL;
+}
+
+
+//average has enough samples to work with?
+bool average_has_enough_data(average_data_t *avg){
+        return avg->data_count>=avg->window_size;
+}
+
+
+//put slot into heap position
+static inline void heap_set(average_data_t *avg, bool low, int pos, int slot){
+        if(low){
+                avg->low[pos] = slot;
+                avg->heap_pos[slot] = -pos-1;
+        }else{
+                avg->high[pos] = slot;
+                avg->heap_pos[slot] = pos;
+        }
+}
+
+
+//slot a should be closer to heap top than slot b?
+static inline bool heap_before(average_data_t *avg, bool low, int a, int b){
+        if(low){
+                return avg->buffer[a] > avg->buffer[b];
+        }
+        return avg->buffer[a] < avg->buffer[b];
+}
+
+
+//move slot at pos to the top while it is out of order
+static void heap_sift_up(average_data_t *avg, bool low, int pos){
+        int *heap = low ? avg->low : avg->high;
+        int slot = heap[pos];
+        while(pos>0){
+                int parent = (pos-1)/2;
+                if(!heap_before(avg, low, slot, heap[parent])){
+                        break;
+                }
+                heap_set(avg, low, pos, heap[parent]);
+                pos = parent;
+        }
+        heap_set(avg, low, pos, slot);
+}
+
+
+//move slot at pos to the bottom while it is out of order
+static void heap_sift_down(average_data_t *avg, bool low, int pos){
+        int *heap = low ? avg->low : avg->high;
+        int n = low ? avg->low_n : avg->high_n;
+        int slot = heap[pos];
+        for(;;){
+                int child = 2*pos+1;
+                if(child>=n){
+                        break;
+                }
+                if(child+1<n && heap_before(avg, low, heap[child+1], heap[child])){
+                        child++;
+                }
+                if(!heap_before(avg, low, heap[child], slot)){
+                        break;
+                }
+                heap_set(avg, low, pos, heap[child]);
+                pos = child;
+        }
+        heap_set(avg, low, pos, slot);
+}
+
+
+static void heap_push(average_data_t *avg, bool low, int slot){
+        int pos = low ? avg->low_n++ : avg->high_n++;
+        heap_set(avg, low, pos, slot);
+        heap_sift_up(avg, low, pos);
+}
+
+
+static int heap_pop(average_data_t *avg, bool low){
+        int *heap = low ? avg->low : avg->high;
+        int last = low ? --avg->low_n : --avg->high_n;
+        int slot = heap[0];
+        if(last>0){
+                heap_set(avg, low, 0, heap[last]);
+                heap_sift_down(avg, low, 0);
+        }
+        return slot;
+}
+
+
+//add new slot while window is not full yet
+//keeps low half size at count/2, so high top is sorted[count/2]
+static void median_insert(average_data_t *avg, int slot){
+        if(avg->high_n>0 && avg->buffer[slot]<avg->buffer[avg->high[0]]){
+                heap_push(avg, true, slot);
+        }else{
+                heap_push(avg, false, slot);
+        }
+        int count = avg->low_n+avg->high_n;
+        while(avg->low_n>count/2){
+                heap_push(avg, false, heap_pop(avg, true));
+        }
+        while(avg->low_n<count/2){
+                heap_push(avg, true, heap_pop(avg, false));
+        }
+}
+
+
+//slot value was replaced, restore heaps order
+static void median_replace(average_data_t *avg, int slot){
+        int pos = avg->heap_pos[slot];
+        bool low = pos<0;
+        if(low){
+                pos = -pos-1;
+        }
+        heap_sift_up(avg, low, pos);
+        pos = avg->heap_pos[slot];
+        heap_sift_down(avg, low, low ? -pos-1 : pos);
+
+        //only one value changed, so at most one pair of tops is out of order
+        if(avg->low_n>0 && avg->buffer[avg->low[0]]>avg->buffer[avg->high[0]]){
+                int a = avg->low[0];
+                int b = avg->high[0];
+                heap_set(avg, true, 0, b);
+                heap_set(avg, false, 0, a);
+                heap_sift_down(avg, true, 0);
+                heap_sift_down(avg, false, 0);
+        }
+}
+
+
+//update averages with new sample
+void update_average(average_data_t *avg, int value){
+        int n = avg->window_size;
+        int slot = avg->circular_index;
+
+        avg->last_value = value;
+        if(value<avg->min_value){
+                avg->min_value = value;
+        }
+        if(value>avg->max_value){
+                avg->max_value = value;
+        }
+
+        if(avg->data_count<n){
+                avg->buffer[slot] = value;
+                median_insert(avg, slot);
+        }else{
+                int old = avg->buffer[slot];
+                avg->sum -= old;
+                avg->sum_sq -= (int64_t)old*old;
+                avg->buffer[slot] = value;
+                median_replace(avg, slot);
+        }
+        avg->sum += value;
+        avg->sum_sq += (int64_t)value*value;
+
+        avg->data_count++;
+        avg->circular_index++;
+        if(avg->circular_index>=n){
+                avg->circular_index = 0;
+        }
+
+        if(avg->data_count>=n){
+                avg->average = (double)avg->sum/n;
+                //n*sum((x-avg)^2) = n*sum(x^2) - sum(x)^2, exact in integers
+                __int128 deviation = avg->sum_sq*n - (__int128)avg->sum*avg->sum;
+                avg->rmsd = sqrt((double)deviation/((double)n*n));
+
+                avg->median = avg->buffer[avg->high[0]];
+                if(avg->median<avg->min_value_filtered){
+                        avg->min_value_filtered = avg->median;
+                }
+                if(avg->median>avg->max_value_filtered){
+                        avg->max_value_filtered = avg->median;
+                }
+        }
+}
@@ -0,0 +1,50 @@
+#ifndef AVERAGE_H
+#define AVERAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//average calculation struct
+//keeps sliding window of last window_size values and calculates average, median and root-square-mean deviation
+//median uses two heaps over window slots (max-heap of lower half, min-heap of upper half), O(log n) per value
+//average and rmsd use running sum and sum of squares, O(1) per value
+typedef struct average_data {
+        int window_size;
+        int data_count;
+        int circular_index;//next slot to write, oldest value when window is full
+        int *buffer;//window values, window_size slots
+
+        int *low;//max-heap of slot indices
+        int *high;//min-heap of slot indices
+        int *heap_pos;//slot position in heap, >=0 for high, <0 (-pos-1) for low
+        int low_n;
+        int high_n;
+
+        int64_t sum;
+        __int128 sum_sq;
+
+        double average;
+        double rmsd;
+
+        int last_value;
+        int median;
+        int min_value;
+        int max_value;
+        int min_value_filtered;
+        int max_value_filtered;
+} average_data_t;
+
+
+//init averaging structure for window of window_size values, returns 0 on success
+int init_average(average_data_t *avg, int window_size);
+
+//release window buffers
+void free_average(average_data_t *avg);
+
+//average has enough samples to work with?
+bool average_has_enough_data(average_data_t *avg);
+
+//update averages with new sample
+void update_average(average_data_t *avg, int value);
+
+#endif
@@ -0,0 +1,361 @@
+#!/bin/bash
+#differential check of pwm decoding engines against per-sample reference decoder (pwmref)
+#run by make check from repository root
+#
+#every engine must give exactly the same dump and summary (pulse statistics, sbus bytes and errors,
+#dshot frame counts) as reference on bundled captures and on random generated streams,
+#merged decoding of two fifos must give the dumps of single inputs
+#throughput of every engine is measured on generated stream, check fails when engine is not
+#CHECK_MIN_SPEEDUP times faster than reference decoder on same machine, or when it is slower than
+#stored baseline by more than CHECK_TOLERANCE percent
+#
+#environment:
+#  CHECK_DIR          work directory (obj/check)
+#  CHECK_SEED         seed of random streams (random, printed for reproduction)
+#  CHECK_MIN_SPEEDUP  minimal throughput of every engine as multiple of reference throughput (20)
+#  CHECK_TOLERANCE    allowed throughput regression against baseline in percent (25)
+#  CHECK_UPDATE       1 to store measured throughput as new baseline
+
+DIR=${CHECK_DIR:-obj/check}
+SEED=${CHECK_SEED:-$(( (RANDOM<<15) | RANDOM ))}
+MIN_SPEEDUP=${CHECK_MIN_SPEEDUP:-20}
+TOLERANCE=${CHECK_TOLERANCE:-25}
+BASELINE=$DIR/throughput.baseline
+PWM=./pwm
+REF=./pwmref
+GEN=./pwmgen
+QRY=./pwmquery
+
+ENGINES="stream mapped threaded chunked index"
+failed=0
+
+mkdir -p "$DIR" || exit 1
+
+
+#run engine on input file: engine name, input, output prefix, pwm options
+run_engine(){
+        local engine=$1 input=$2 out=$3
+        shift 3
+        case $engine in
+        stream)
+                $PWM -r 0 -d "$out.dump" "$@" <"$input" ;;
+        mapped)
+                $PWM -r 0 -d "$out.dump" "$@" -i "$input" ;;
+        threaded)
+                $PWM -r 0 -d "$out.dump" -j 3 "$@" <"$input" ;;
+        chunked)
+                $PWM -r 0 -d "$out.dump" -P 3 "$@" -i "$input" ;;
+        index)
+                $PWM -r 0 -W "$out.idx" "$@" -i "$input" >/dev/null &&
+                $PWM -r 0 -d "$out.dump" "$@" -X "$out.idx" ;;
+        esac >"$out.out" 2>"$out.err"
+}
+
+
+#summary lines shared by pwm and reference: pulse counts, averages, sbus byte and error counts
+summary(){
+        grep -E '^p:|:avg:' "$1"
+}
+
+
+#dump as one sorted line per event, sbus packet lines are joined to their event
+#dshot frame is written when its last bit ends but is stamped with its first bit, so engines
+#and reference order frames differently against events of other probes
+events(){
+        awk '/^t:|^[0-9]+,/{if(e!="")print e; e=$0; next} {e=e "|" $0} END{if(e!="")print e}' "$1" | sort
+}
+
+
+#dumps are equal, as sorted events if sorted_events is set
+same_dump(){
+        if [ -n "$sorted_events" ]; then
+                cmp -s <(events "$1") <(events "$2")
+        else
+                cmp -s "$1" "$2"
+        fi
+}
+
+
+#compare all engines with reference: test name, input, reference options, pwm options
+compare(){
+        local name=$1 input=$2 ref_options=$3
+        shift 3
+        local ref=$DIR/$name.ref
+        if ! $REF $ref_options -d "$ref.dump" <"$input" >"$ref.out"; then
+                echo "FAIL $name: reference decoder error"
+                failed=1
+                return
+        fi
+        local result="$name:"
+        for engine in $ENGINES; do
+                local out=$DIR/$name.$engine
+                if ! run_engine $engine "$input" "$out" "$@"; then
+                        echo "FAIL $name $engine: pwm error, see $out.err"
+                        failed=1
+                elif ! same_dump "$ref.dump" "$out.dump"; then
+                        echo "FAIL $name $engine: dump differs from reference"
+                        diff "$ref.dump" "$out.dump" | head -5
+                        failed=1
+                elif ! diff -q <(summary "$ref.out") <(summary "$out.out") >/dev/null; then
+                        echo "FAIL $name $engine: summary differs from reference"
+                        diff <(summary "$ref.out") <(summary "$out.out") | head -5
+                        failed=1
+                else
+                        result="$result $engine"
+                fi
+        done
+        [ "$result" != "$name:" ] && echo "$result ok"
+}
+
+
+#bundled captures
+tar -xzf test_data.tar.gz -C "$DIR" test_data/probe_all.bin test_data/probe0.bin || exit 1
+tar -xzf test_data_sbus.tgz -C "$DIR" test_data_sbus || exit 1
+compare capture_pwm "$DIR/test_data/probe_all.bin" "-s 100" -s 100
+compare capture_pwm0 "$DIR/test_data/probe0.bin" "-s 100" -s 100
+compare capture_sbus "$DIR/test_data_sbus" "-s 2000 -b" -s 2000 -b
+
+#random streams: jittered pulses overlapping period, sbus with errors, noise on sbus and wide samples
+echo "random streams, CHECK_SEED=$SEED"
+$GEN -s 1000 -t 4 -r $SEED -g 0-7:pwm,period=2000,width=1000,jitter=950,phase=37 >"$DIR/random_pwm.bin" &&
+$GEN -s 2000 -t 4 -r $((SEED+1)) -g 0-3:sbus,period=7,ramp=5,failsafe=7,lost=11,parity=5 -g 4-5:noise,run=7 -g 6-7:noise,run=60 \
+        >"$DIR/random_sbus.bin" &&
+$GEN -s 500 -t 4 -u 2 -r $((SEED+2)) -g 0-7:noise,run=150 -g 8-15:pwm,period=1000,width=400,jitter=390 >"$DIR/random_wide.bin" &&
+$GEN -s 1000 -t 4 -r $((SEED+3)) -g 0-7:pwm,period=1500,width=500,jitter=480,phase=53 >"$DIR/random_pwm2.bin" ||
+        exit 1
+compare random_pwm "$DIR/random_pwm.bin" "-s 1000" -s 1000
+compare random_sbus "$DIR/random_sbus.bin" "-s 2000 -b" -s 2000 -b
+compare random_wide "$DIR/random_wide.bin" "-s 500 -u 2" -s 500 -u 2
+compare random_pwm2 "$DIR/random_pwm2.bin" "-s 1000" -s 1000
+
+#sbus at 500k, below reference rates, and 1500k: errors, frame and flag counts of every engine must be those
+#injected by generator; 2 s of 7 ms frames, the last frame is pending at end of capture
+#probes 0-1 carry lost and failsafe flags (failsafe sets lost flag too), probes 2-3 parity errors which break frames
+sbus_counts(){
+        awk '/^p:/{p=$1} /^p:[0-3] /{print $1, $2, $3} (p=="p:0" || p=="p:1") && /^frames:/{print p, $1, $2, $3, $4}' "$1"
+}
+awk 'BEGIN{
+        n=int((2000+6)/7)
+        for(i=0;i<n-1;i++){lost+=(i%11==10 || i%7==6); failsafe+=(i%7==6)}
+        for(i=0;i<n;i++){parity+=(i%5==4)}
+        for(p=0;p<2;p++){printf "p:%d errors:0 parity_errors:0\np:%d frames:%d bad:0 lost:%d failsafe:%d\n", p, p, n-1, lost, failsafe}
+        for(p=2;p<4;p++){printf "p:%d errors:0 parity_errors:%d\n", p, parity}
+}' >"$DIR/sbus_rates.expected"
+for rate in 500 1500; do
+        $GEN -s $rate -t 2 -r $((SEED+6)) -g 0-1:sbus,period=7,ramp=5,lost=11,failsafe=7 -g 2-3:sbus,period=7,parity=5 \
+                >"$DIR/sbus_$rate.bin" || exit 1
+        result="sbus_$rate:"
+        for engine in $ENGINES; do
+                out=$DIR/sbus_$rate.$engine
+                if ! run_engine $engine "$DIR/sbus_$rate.bin" "$out" -s $rate -b; then
+                        echo "FAIL sbus_$rate $engine: pwm error, see $out.err"
+                        failed=1
+                elif ! diff -q "$DIR/sbus_rates.expected" <(sbus_counts "$out.out") >/dev/null; then
+                        echo "FAIL sbus_$rate $engine: counts differ from generated errors"
+                        diff "$DIR/sbus_rates.expected" <(sbus_counts "$out.out") | head -5
+                        failed=1
+                else
+                        result="$result $engine"
+                fi
+        done
+        [ "$result" != "sbus_$rate:" ] && echo "$result ok"
+done
+#reference decoder takes 1500k
+compare sbus_1500_ref "$DIR/sbus_1500.bin" "-s 1500 -b" -s 1500 -b
+
+#dshot with crc errors and telemetry requests, noise and pwm pulses give bit errors
+#mixed protocols per probe, dshot at three bit rates
+$GEN -s 24000 -t 0.5 -r $((SEED+4)) -g 0-3:dshot,rate=600,period=125,ramp=3,telemetry=5,crc=7 -g 4-5:noise,run=1 \
+        -g 6-7:pwm,period=1000,width=500,jitter=400 >"$DIR/random_dshot.bin" &&
+$GEN -s 24000 -t 1 -r $((SEED+5)) -g 0-1:dshot,rate=300,period=250,ramp=7,crc=5 -g 2-3:sbus,period=7,ramp=5,parity=5 \
+        -g 4-5:pwm,period=2000,width=1000,jitter=900 -g 6:noise,run=2 -g 7:dshot,rate=1200,period=100,telemetry=3 \
+        >"$DIR/random_mixed.bin" ||
+        exit 1
+MIXED=0-1:dshot300,2-3:sbus,4-5:pwm,6:dshot600,7:dshot1200
+sorted_events=1 compare random_dshot "$DIR/random_dshot.bin" "-s 24000 -x 600" -s 24000 -x 600
+sorted_events=1 compare random_mixed "$DIR/random_mixed.bin" "-s 24000 -p $MIXED" -s 24000 -p $MIXED
+
+#summary lines of merged probes first..first+7, numbered from 0
+merged_summary(){
+        summary "$1" | awk -v first=$2 '/^p:/{p=$2} p>=first && p<first+8{if(/^p:/)sub(/^p: [0-9]+/, "p: " p-first); print}'
+}
+
+#two fifos decoded as one capture, probes 0-7 come from first input and 8-15 from second,
+#each half must equal reference of single input
+rm -f "$DIR/merge_a" "$DIR/merge_b"
+mkfifo "$DIR/merge_a" "$DIR/merge_b" || exit 1
+cat "$DIR/random_pwm.bin" >"$DIR/merge_a" &
+writer_a=$!
+cat "$DIR/random_pwm2.bin" >"$DIR/merge_b" &
+writer_b=$!
+$PWM -r 0 -s 1000 -d "$DIR/merge.dump" -i "$DIR/merge_a" -i "$DIR/merge_b" >"$DIR/merge.out" 2>"$DIR/merge.err"
+status=$?
+#writers of fifo which was not opened would block
+kill $writer_a $writer_b 2>/dev/null
+wait $writer_a $writer_b 2>/dev/null
+if [ $status != 0 ]; then
+        echo "FAIL merge: pwm error, see $DIR/merge.err"
+        failed=1
+elif ! cmp -s <(awk -F, '$1<8' "$DIR/merge.dump") "$DIR/random_pwm.ref.dump" ||
+     ! cmp -s <(awk -F, 'BEGIN{OFS=","} $1>=8{$1-=8; print}' "$DIR/merge.dump") "$DIR/random_pwm2.ref.dump"; then
+        echo "FAIL merge: dump differs from single input reference"
+        failed=1
+elif ! diff -q <(merged_summary "$DIR/merge.out" 0) <(summary "$DIR/random_pwm.ref.out") >/dev/null ||
+     ! diff -q <(merged_summary "$DIR/merge.out" 8) <(summary "$DIR/random_pwm2.ref.out") >/dev/null; then
+        echo "FAIL merge: summary differs from single input reference"
+        failed=1
+else
+        echo "merge: two fifos ok"
+fi
+
+#value store: widths of every probe read back by pwmquery must equal widths of reference dump
+if $PWM -r 0 -s 1000 -V "$DIR/random_pwm.pvs" -i "$DIR/random_pwm.bin" >/dev/null; then
+        result="value store: ok"
+        for probe in 0 1 2 3 4 5 6 7; do
+                if ! cmp -s <(awk -F, -v p=$probe '$1==p{printf "%.6f,%d\n", $3/1e6, $4}' "$DIR/random_pwm.ref.dump") \
+                        <($QRY -i "$DIR/random_pwm.pvs" -p $probe -c width | tail -n +2); then
+                        result="FAIL value store: widths of probe $probe differ from reference"
+                        failed=1
+                fi
+        done
+        echo "$result"
+else
+        echo "FAIL value store: pwm error"
+        failed=1
+fi
+
+#sigrok session file: wide stream split in two logic chunks, samplerate, unitsize and probe count come only
+#from metadata and must give the same dump and summary as raw input with the same settings on command line
+if command -v zip >/dev/null; then
+        sr=$DIR/session
+        rm -rf "$sr"
+        mkdir -p "$sr" || exit 1
+        head -c 1000002 "$DIR/random_wide.bin" >"$sr/logic-1-1"
+        tail -c +1000003 "$DIR/random_wide.bin" >"$sr/logic-1-2"
+        printf '[global]\nsigrok version=0.5.2\n\n[device 1]\ncapturefile=logic-1\ntotal probes=12\nsamplerate=500 kHz\n%s\nunitsize=2\n' \
+                'probe1=N0
+probe9=P8
+probe12=P11' >"$sr/metadata"
+        (cd "$sr" && zip -q -X capture.sr metadata logic-1-1 logic-1-2) || exit 1
+        $PWM -r 0 -s 500 -u 2 -c 0-11 -d "$sr/raw.dump" -i "$DIR/random_wide.bin" >"$sr/raw.out" 2>"$sr/raw.err"
+        result="session file:"
+        for engine in stream threaded chunked; do
+                case $engine in
+                stream) options= ;;
+                threaded) options="-j 3" ;;
+                chunked) options="-P 3" ;;
+                esac
+                out=$sr/$engine
+                if ! $PWM -r 0 -d "$out.dump" $options -i "$sr/capture.sr" >"$out.out" 2>"$out.err"; then
+                        echo "FAIL session file $engine: pwm error, see $out.err"
+                        failed=1
+                elif ! grep -q 'capture.sr: samplerate 500000 Hz, unitsize 2, probes: 0:N0 8:P8 11:P11$' "$out.err" ||
+                     [ "$(awk '/^p:/{printf "%s ", $2}' "$out.out")" != "0 1 2 3 4 5 6 7 8 9 10 11 " ]; then
+                        echo "FAIL session file $engine: metadata not used, see $out.err"
+                        failed=1
+                elif ! cmp -s "$sr/raw.dump" "$out.dump" || ! diff -q <(summary "$sr/raw.out") <(summary "$out.out") >/dev/null; then
+                        echo "FAIL session file $engine: dump or summary differs from raw input"
+                        failed=1
+                else
+                        result="$result $engine"
+                fi
+        done
+        [ "$result" != "session file:" ] && echo "$result ok"
+else
+        echo "session file: skipped, zip not found"
+fi
+
+#trigger history:sbus errors and pwm widths out of range close together, every engine must write the same
+#trigger files as stream engine, whatever its block size
+$GEN -s 1500 -t 2 -r $((SEED+7)) -g 0-1:sbus,period=7,lost=13,failsafe=17,parity=11 -g 2-3:pwm,period=2500,jitter=700 \
+        >"$DIR/trigger.bin" || exit 1
+result="trigger:"
+for engine in $ENGINES; do
+        out=$DIR/trigger.$engine
+        rm -f "$out"-*.bin
+        if ! run_engine $engine "$DIR/trigger.bin" "$out" -s 1500 -p 0-1:sbus,2-3:pwm -T all,width=900-1800 -B 0.2:0.05 -O "$out"; then
+                echo "FAIL trigger $engine: pwm error, see $out.err"
+                failed=1
+                continue
+        fi
+        tail -n 1 "$out.err" >"$out.count"
+        if [ $engine = stream ]; then
+                if ! grep -qE '^triggers:[0-9]+ dumps:([2-9]|[1-9][0-9]+)$' "$out.count"; then
+                        echo "FAIL trigger stream: expected several dumps, see $out.err"
+                        failed=1
+                fi
+        elif ! cmp -s "$DIR/trigger.stream.count" "$out.count"; then
+                echo "FAIL trigger $engine: $(cat "$out.count"), stream engine $(cat "$DIR/trigger.stream.count")"
+                failed=1
+                continue
+        fi
+        same=1
+        for f in "$DIR"/trigger.stream-*.bin; do
+                cmp -s "$f" "$out${f#$DIR/trigger.stream}" || same=0
+        done
+        if [ $same = 0 ]; then
+                echo "FAIL trigger $engine: trigger files differ from stream engine"
+                failed=1
+        else
+                result="$result $engine"
+        fi
+done
+[ "$result" != "trigger:" ] && echo "$result ok"
+
+
+#throughput, best of 5 runs per engine
+PERF_INPUT=$DIR/perf.bin
+test -f "$PERF_INPUT" || $GEN -s 24000 -t 4 -g 0-7:pwm,period=2500,width=1500,jitter=2,phase=300 >"$PERF_INPUT" || exit 1
+#reference throughput on first 0.5 s of perf input, sets minimal throughput of engines without any baseline
+head -c 12000000 "$PERF_INPUT" >"$DIR/perf_ref.bin" || exit 1
+start=$(date +%s%N)
+$REF -s 24000 <"$DIR/perf_ref.bin" >/dev/null || exit 1
+end=$(date +%s%N)
+ref_rate=$(awk -v ns=$((end-start)) 'BEGIN{printf "%.2f", 12000000*1000/ns}')
+min_rate=$(awk -v r=$ref_rate -v m=$MIN_SPEEDUP 'BEGIN{printf "%.2f", r*m}')
+echo "reference: $ref_rate MSamples/s, engines need $min_rate MSamples/s (CHECK_MIN_SPEEDUP=$MIN_SPEEDUP)"
+: >"$DIR/throughput"
+for engine in $ENGINES; do
+        best=0
+        for run in 1 2 3 4 5; do
+                out=$DIR/perf.$engine
+                if [ $engine = index ]; then
+                        #decoding from index, index is written by first run
+                        test -f "$out.idx" || $PWM -r 0 -s 24000 -W "$out.idx" -i "$PERF_INPUT" >/dev/null || exit 1
+                        $PWM -r 0 -s 24000 -X "$out.idx" >"$out.out" 2>/dev/null
+                else
+                        run_engine $engine "$PERF_INPUT" "$out" -s 24000
+                fi
+                t=$(sed -n 's/.*throughput:\([0-9.]*\) MSamples.*/\1/p' "$out.out")
+                best=$(awk -v a="${t:-0}" -v b=$best 'BEGIN{print (a>b) ? a : b}')
+        done
+        echo "$engine $best" >>"$DIR/throughput"
+done
+if [ ! -f "$BASELINE" ] || [ "$CHECK_UPDATE" = 1 ]; then
+        cp "$DIR/throughput" "$BASELINE"
+        echo "throughput baseline stored in $BASELINE"
+fi
+while read engine value; do
+        if awk -v v=$value -v m=$min_rate 'BEGIN{exit !(v < m)}'; then
+                echo "FAIL $engine: $value MSamples/s, less than $MIN_SPEEDUP times reference"
+                failed=1
+                continue
+        fi
+        base=$(awk -v e=$engine '$1==e{print $2}' "$BASELINE")
+        if [ -z "$base" ]; then
+                echo "$engine: $value MSamples/s (no baseline)"
+                continue
+        fi
+        if awk -v v=$value -v b=$base -v t=$TOLERANCE 'BEGIN{exit !(v < b*(100-t)/100)}'; then
+                echo "FAIL $engine: $value MSamples/s, baseline $base MSamples/s"
+                failed=1
+        else
+                echo "$engine: $value MSamples/s, baseline $base MSamples/s"
+        fi
+done <"$DIR/throughput"
+
+if [ $failed != 0 ]; then
+        echo "check failed"
+        exit 1
+fi
+echo "check passed"
@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include "pwm.h"
+
+//offline processing of mapped capture file:
+//extraction threads scan consecutive blocks in parallel, every block starts from the last sample
+//of previous block, so its edges are exactly the edges of sequential scan
+//caller thread decodes edges of blocks in order while next round of blocks is scanned,
+//so decoder state never has to be stitched and results are identical to sequential run
+
+typedef struct chunk {
+        const uint8_t *data;//block in mapped input
+        size_t samples;
+        int64_t base_time;
+        uint32_t prev_sample;//last sample of previous block
+        int64_t arrival_ns;//block was taken from input
+
+        edge_t *edges;
+        int edges_n;
+        int capacity;
+        int error;
+} chunk_t;
+
+struct chunked;
+
+typedef struct chunk_worker {
+        struct chunked *c;
+        int idx;
+        pthread_t thread;
+} chunk_worker_t;
+
+typedef struct chunked {
+        context_t *ctx;
+        int threads;
+        chunk_t *sets[2];//one set of blocks is scanned while other is decoded
+        int chunks_n[2];
+        int current;//set being scanned
+        bool stop;
+        bool ready;//all workers are created, barriers are initialized
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        pthread_barrier_t start;
+        pthread_barrier_t done;
+        chunk_worker_t *workers;
+} chunked_t;
+
+
+//scan block into growing edges array
+static void extract_chunk(context_t *ctx, chunk_t *chunk){
+        edge_detector_t det;
+        init_edge_detector(&det, ctx->probe_mask);
+        det.last_sample = chunk->prev_sample;
+        chunk->edges_n = 0;
+        size_t pos = 0;
+        while(pos<chunk->samples){
+                if(chunk->capacity-chunk->edges_n<EDGE_BUFFER_SIZE){
+                        int capacity = chunk->capacity ? chunk->capacity*2 : EDGE_BUFFER_SIZE*2;
+                        edge_t *edges = realloc(chunk->edges, capacity*sizeof(edge_t));
+                        if(edges==NULL){
+                                chunk->error = 1;
+                                return;
+                        }
+                        chunk->edges = edges;
+                        chunk->capacity = capacity;
+                }
+                chunk->edges_n += extract_edges(&det, ctx->unitsize, chunk->data, chunk->samples, &pos, chunk->base_time,
+                                                chunk->edges+chunk->edges_n, EDGE_BUFFER_SIZE);
+        }
+}
+
+
+static void *chunk_worker_thread(void *arg){
+        chunk_worker_t *w = arg;
+        chunked_t *c = w->c;
+        pthread_mutex_lock(&c->lock);
+        while(!c->ready){
+                pthread_cond_wait(&c->cond, &c->lock);
+        }
+        pthread_mutex_unlock(&c->lock);
+        if(c->stop){
+                //other worker was not created
+                return NULL;
+        }
+        for(;;){
+                pthread_barrier_wait(&c->start);
+                if(c->stop){
+                        return NULL;
+                }
+                int set = c->current;
+                if(w->idx<c->chunks_n[set]){
+                        int64_t t = monitor_now();
+                        extract_chunk(c->ctx, &c->sets[set][w->idx]);
+                        monitor_stage(monitor, STAGE_DECODE, t);
+                }
+                pthread_barrier_wait(&c->done);
+        }
+}
+
+
+//take next blocks of input into set, returns number of blocks, -1 on error
+static int fill_set(chunked_t *c, input_t *in, int set, int64_t *base_time, uint32_t *prev_sample){
+        int unitsize = c->ctx->unitsize;
+        int n;
+        for(n=0;n<c->threads;n++){
+                const uint8_t *block;
+                int64_t t = monitor_now();
+                ssize_t len = input_next_block(in, &block);
+                int64_t arrival = monitor_stage(monitor, STAGE_READ, t);
+                if(len<0){
+                        return -1;
+                }
+                if(len==0){
+                        break;
+                }
+                chunk_t *chunk = &c->sets[set][n];
+                chunk->data = block;
+                chunk->samples = len/unitsize;
+                chunk->base_time = *base_time;
+                chunk->prev_sample = *prev_sample;
+                chunk->arrival_ns = arrival;
+                chunk->error = 0;
+                *base_time += chunk->samples;
+                *prev_sample = load_sample(block+len-unitsize, unitsize);
+        }
+        c->chunks_n[set] = n;
+        return n;
+}
+
+
+//decode scanned blocks of set in order
+static int decode_set(chunked_t *c, decoder_t *decoder, int set, display_t *display){
+        context_t *ctx = c->ctx;
+        event_buffer_t *events = &decoder->events;
+        for(int i=0;i<c->chunks_n[set];i++){
+                chunk_t *chunk = &c->sets[set][i];
+                if(chunk->error){
+                        fprintf(stderr, "error allocate edges\n");
+                        return 1;
+                }
+                int64_t t = monitor_now();
+                decoder->edges_n += chunk->edges_n;
+                if(edge_index!=NULL){
+                        edge_index_add(edge_index, chunk->edges, chunk->edges_n);
+                }
+                if(history!=NULL){
+                        history_add(history, chunk->edges, chunk->edges_n);
+                }
+                decode_edges(ctx, chunk->edges, chunk->edges_n);
+                decode_end(ctx, decoder, chunk->base_time+chunk->samples);
+                ctx->line_num += chunk->samples;
+                t = monitor_stage(monitor, STAGE_DECODE, t);
+                if(dump_enabled || history!=NULL){
+                        output_events(&events, 1);
+                }
+                event_buffer_clear(events);
+                if(history!=NULL){
+                        history_check(history, chunk->base_time+chunk->samples);
+                }
+
+                if(display_wanted(display)){
+                        ctx->edges_n = decoder->edges_n;
+                        display_publish(display, ctx);
+                }
+                if(telemetry!=NULL){
+                        ctx->edges_n = decoder->edges_n;
+                        telemetry_publish(telemetry, ctx);
+                }
+                monitor_stage(monitor, STAGE_OUTPUT, t);
+                monitor_block(monitor, chunk->arrival_ns, chunk->samples, decoder->edges_n, count_frames(ctx->probes, ctx->probes_n));
+        }
+        return 0;
+}
+
+
+static void free_chunked(chunked_t *c){
+        for(int s=0;s<2;s++){
+                if(c->sets[s]!=NULL){
+                        for(int i=0;i<c->threads;i++){
+                                free(c->sets[s][i].edges);
+                        }
+                        free(c->sets[s]);
+                }
+        }
+        free(c->workers);
+        free(c);
+}
+
+
+//process mapped file, edges of consecutive blocks are extracted in parallel and decoded in order
+int process_data_chunked(context_t *ctx, input_t *in, display_t *display, int threads){
+        if(!input_is_mapped(in)){
+                //blocks of stream input do not stay valid
+                return process_data_threaded(ctx, in, display, threads);
+        }
+        if(init_probes(ctx, 31-__builtin_clz(ctx->probe_mask))){
+                return 1;
+        }
+        chunked_t *c = calloc(1, sizeof(chunked_t));
+        decoder_t *decoder = malloc(sizeof(decoder_t));
+        if(c==NULL || decoder==NULL){
+                fprintf(stderr, "error allocate decoder\n");
+                free(c);
+                free(decoder);
+                return 1;
+        }
+        c->ctx = ctx;
+        c->threads = threads;
+        c->sets[0] = calloc(threads, sizeof(chunk_t));
+        c->sets[1] = calloc(threads, sizeof(chunk_t));
+        c->workers = calloc(threads, sizeof(chunk_worker_t));
+        if(c->sets[0]==NULL || c->sets[1]==NULL || c->workers==NULL){
+                fprintf(stderr, "error allocate decoder\n");
+                free_chunked(c);
+                free(decoder);
+                return 1;
+        }
+        init_decoder(decoder, ctx, ctx->probe_mask);
+
+        //workers and caller meet at barriers
+        pthread_mutex_init(&c->lock, NULL);
+        pthread_cond_init(&c->cond, NULL);
+        pthread_barrier_init(&c->start, NULL, threads+1);
+        pthread_barrier_init(&c->done, NULL, threads+1);
+        int started;
+        int r = 0;
+        for(started=0;started<threads;started++){
+                c->workers[started].c = c;
+                c->workers[started].idx = started;
+                r = pthread_create(&c->workers[started].thread, NULL, chunk_worker_thread, &c->workers[started]);
+                if(r!=0){
+                        fprintf(stderr, "error create thread %s\n", strerror(r));
+                        c->stop = true;
+                        break;
+                }
+        }
+        pthread_mutex_lock(&c->lock);
+        c->ready = true;
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->lock);
+
+        int error = r!=0;
+        int64_t base_time = 0;
+        uint32_t prev_sample = 0;
+        int set = 0;
+        if(!error){
+                c->current = set;
+                if(fill_set(c, in, set, &base_time, &prev_sample)<0){
+                        error = 1;
+                }
+                pthread_barrier_wait(&c->start);
+                pthread_barrier_wait(&c->done);
+        }
+        while(!error && c->chunks_n[set]>0){
+                int next = set^1;
+                if(fill_set(c, in, next, &base_time, &prev_sample)<0){
+                        c->chunks_n[next] = 0;
+                        error = 1;
+                }
+                c->current = next;
+                pthread_barrier_wait(&c->start);
+                if(decode_set(c, decoder, set, display)){
+                        error = 1;
+                }
+                pthread_barrier_wait(&c->done);
+                set = next;
+        }
+
+        if(!c->stop){
+                c->stop = true;
+                pthread_barrier_wait(&c->start);
+        }
+        for(int i=0;i<started;i++){
+                pthread_join(c->workers[i].thread, NULL);
+        }
+        pthread_barrier_destroy(&c->start);
+        pthread_barrier_destroy(&c->done);
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->lock);
+
+        ctx->edges_n = decoder->edges_n;
+        free_decoder(decoder);
+        free(decoder);
+        free_chunked(c);
+        return error;
+}
@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+
+#include "device.h"
+
+
+//copy samples of unitsize bytes to device buffer of d->unitsize bytes per sample, returns false on error
+static bool repack(device_t *d, const uint8_t *src, int unitsize, size_t samples){
+        size_t size = samples*d->unitsize;
+        if(size>d->repack_size){
+                uint8_t *buffer = realloc(d->repack, size);
+                if(buffer==NULL){
+                        fprintf(stderr, "error allocate device buffer\n");
+                        return false;
+                }
+                d->repack = buffer;
+                d->repack_size = size;
+        }
+        int n = unitsize<d->unitsize ? unitsize : d->unitsize;
+        uint8_t *dst = d->repack;
+        for(size_t i=0;i<samples;i++){
+                memcpy(dst, src, n);
+                memset(dst+n, 0, d->unitsize-n);
+                src += unitsize;
+                dst += d->unitsize;
+        }
+        return true;
+}
+
+
+//datafeed callback, runs in session thread
+static void datafeed(const struct sr_dev_inst *sdi, const struct sr_datafeed_packet *packet, void *cb_data){
+        (void)sdi;
+        device_t *d = cb_data;
+        switch(packet->type){
+        case SR_DF_META: {
+                const struct sr_datafeed_meta *meta = packet->payload;
+                for(GSList *l=meta->config;l!=NULL;l=l->next){
+                        struct sr_config *src = l->data;
+                        if(src->key==SR_CONF_SAMPLERATE && g_variant_get_uint64(src->data)!=d->samplerate){
+                                fprintf(stderr, "device samplerate changed to %llu Hz\n", (unsigned long long)g_variant_get_uint64(src->data));
+                        }
+                }
+                break;
+        }
+        case SR_DF_LOGIC: {
+                const struct sr_datafeed_logic *logic = packet->payload;
+                pthread_mutex_lock(&d->lock);
+                const uint8_t *data = logic->data;
+                size_t samples = logic->length / logic->unitsize;
+                if(logic->unitsize!=d->unitsize){
+                        //packet carries more or less bytes per sample than enabled probes need
+                        if(!repack(d, data, logic->unitsize, samples)){
+                                d->error = true;
+                                pthread_cond_broadcast(&d->cond);
+                                pthread_mutex_unlock(&d->lock);
+                                return;
+                        }
+                        data = d->repack;
+                }
+                d->data = data;
+                d->length = samples*d->unitsize;
+                d->ready = true;
+                pthread_cond_broadcast(&d->cond);
+                //packet buffer is valid only during callback, wait until decoder is done with it
+                while(d->ready && !d->stopping){
+                        pthread_cond_wait(&d->cond, &d->lock);
+                }
+                pthread_mutex_unlock(&d->lock);
+                break;
+        }
+        case SR_DF_END:
+                pthread_mutex_lock(&d->lock);
+                d->ended = true;
+                pthread_cond_broadcast(&d->cond);
+                pthread_mutex_unlock(&d->lock);
+                break;
+        default:
+                break;
+        }
+}
+
+
+static void *session_thread(void *arg){
+        device_t *d = arg;
+        int r = sr_session_run(d->session);
+        pthread_mutex_lock(&d->lock);
+        if(r!=SR_OK){
+                fprintf(stderr, "error run session %s\n", sr_strerror(r));
+                d->error = true;
+        }
+        d->ended = true;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+        return NULL;
+}
+
+
+//config value of key type, new floating reference, NULL if value is invalid
+static GVariant *config_value(const struct sr_key_info *info, const char *value){
+        char *end;
+        switch(info->datatype){
+        case SR_T_UINT64: {
+                uint64_t v;
+                if(sr_parse_sizestring(value, &v)!=SR_OK){
+                        return NULL;
+                }
+                return g_variant_new_uint64(v);
+        }
+        case SR_T_INT32: {
+                long v = strtol(value, &end, 10);
+                return *end ? NULL : g_variant_new_int32(v);
+        }
+        case SR_T_FLOAT: {
+                double v = strtod(value, &end);
+                return *end ? NULL : g_variant_new_double(v);
+        }
+        case SR_T_BOOL:
+                return g_variant_new_boolean(strcmp(value, "1")==0 || strcmp(value, "true")==0 || strcmp(value, "yes")==0);
+        case SR_T_STRING:
+                return g_variant_new_string(value);
+        default:
+                return NULL;
+        }
+}
+
+
+//split key=value list separated by ':' into scan options (is_scan) or device config
+static int apply_options(device_t *d, const char *list, bool is_scan, GSList **scan_options){
+        char *copy = strdup(list);
+        if(copy==NULL){
+                return 1;
+        }
+        int error = 0;
+        char *save;
+        for(char *item=strtok_r(copy, ":", &save);item!=NULL && !error;item=strtok_r(NULL, ":", &save)){
+                char *value = strchr(item, '=');
+                if(value==NULL){
+                        fprintf(stderr, "invalid device option %s, must be key=value\n", item);
+                        error = 1;
+                        break;
+                }
+                *value++ = 0;
+                const struct sr_key_info *info = sr_key_info_name_get(SR_KEY_CONFIG, item);
+                GVariant *v = info!=NULL ? config_value(info, value) : NULL;
+                if(v==NULL){
+                        fprintf(stderr, "invalid device option %s=%s\n", item, value);
+                        error = 1;
+                        break;
+                }
+                if(is_scan){
+                        struct sr_config *src = g_malloc(sizeof(struct sr_config));
+                        src->key = info->key;
+                        src->data = g_variant_ref_sink(v);
+                        *scan_options = g_slist_append(*scan_options, src);
+                        continue;
+                }
+                //some keys belong to channel group, e.g. demo logic pattern
+                int r = sr_config_set(d->sdi, NULL, info->key, v);
+                for(GSList *l=sr_dev_inst_channel_groups_get(d->sdi);l!=NULL && r!=SR_OK;l=l->next){
+                        r = sr_config_set(d->sdi, l->data, info->key, config_value(info, value));
+                }
+                if(r!=SR_OK){
+                        fprintf(stderr, "error set device option %s=%s %s\n", item, value, sr_strerror(r));
+                        error = 1;
+                }
+        }
+        free(copy);
+        return error;
+}
+
+
+static void free_scan_option(void *data){
+        struct sr_config *src = data;
+        g_variant_unref(src->data);
+        g_free(src);
+}
+
+
+//open device of driver spec (driver[:conn=...]), apply config (key=value[:key=value]), returns NULL on error
+device_t *device_open(const char *spec, const char *config){
+        device_t *d = calloc(1, sizeof(device_t));
+        if(d==NULL){
+                fprintf(stderr, "error allocate device\n");
+                return NULL;
+        }
+        pthread_mutex_init(&d->lock, NULL);
+        pthread_cond_init(&d->cond, NULL);
+        int r = sr_init(&d->ctx);
+        if(r!=SR_OK){
+                fprintf(stderr, "error init libsigrok %s\n", sr_strerror(r));
+                device_close(d);
+                return NULL;
+        }
+
+        //driver name, then scan options
+        size_t len = strcspn(spec, ":");
+        snprintf(d->name, sizeof(d->name), "%.*s", (int)len, spec);
+        struct sr_dev_driver *driver = NULL;
+        struct sr_dev_driver **drivers = sr_driver_list(d->ctx);
+        for(int i=0;drivers!=NULL && drivers[i]!=NULL;i++){
+                if(strcmp(drivers[i]->name, d->name)==0){
+                        driver = drivers[i];
+                }
+        }
+        if(driver==NULL){
+                fprintf(stderr, "unknown sigrok driver %s\n", d->name);
+                device_close(d);
+                return NULL;
+        }
+        if((r = sr_driver_init(d->ctx, driver))!=SR_OK){
+                fprintf(stderr, "error init driver %s %s\n", d->name, sr_strerror(r));
+                device_close(d);
+                return NULL;
+        }
+        GSList *scan_options = NULL;
+        if(spec[len]==':' && apply_options(d, spec+len+1, true, &scan_options)){
+                g_slist_free_full(scan_options, free_scan_option);
+                device_close(d);
+                return NULL;
+        }
+        GSList *devices = sr_driver_scan(driver, scan_options);
+        g_slist_free_full(scan_options, free_scan_option);
+        if(devices==NULL){
+                fprintf(stderr, "no %s device found\n", d->name);
+                device_close(d);
+                return NULL;
+        }
+        struct sr_dev_inst *sdi = devices->data;
+        g_slist_free(devices);
+        if((r = sr_dev_open(sdi))!=SR_OK){
+                fprintf(stderr, "error open %s device %s\n", d->name, sr_strerror(r));
+                device_close(d);
+                return NULL;
+        }
+        d->sdi = sdi;
+        if(config!=NULL && apply_options(d, config, false, NULL)){
+                device_close(d);
+                return NULL;
+        }
+
+        //samplerate and logic channels as configured on device
+        GVariant *v;
+        if(sr_config_get(driver, sdi, NULL, SR_CONF_SAMPLERATE, &v)==SR_OK){
+                d->samplerate = g_variant_get_uint64(v);
+                g_variant_unref(v);
+        }
+        for(GSList *l=sr_dev_inst_channels_get(sdi);l!=NULL;l=l->next){
+                struct sr_channel *ch = l->data;
+                if(ch->type==SR_CHANNEL_LOGIC && ch->enabled && ch->index<DEVICE_MAX_PROBES){
+                        snprintf(d->probe_names[ch->index], DEVICE_NAME_SIZE, "%s", ch->name);
+                        if(ch->index>=d->probes_n){
+                                d->probes_n = ch->index+1;
+                        }
+                }
+        }
+        if(d->probes_n==0){
+                fprintf(stderr, "%s device has no enabled logic channel below %d\n", d->name, DEVICE_MAX_PROBES);
+                device_close(d);
+                return NULL;
+        }
+        //drivers differ in bytes per sample of logic packets (all channels or enabled channels only),
+        //packets of other unitsize are repacked
+        d->unitsize = (d->probes_n+7)/8;
+        if(d->unitsize==3){
+                d->unitsize = 4;
+        }
+
+        if((r = sr_session_new(d->ctx, &d->session))!=SR_OK ||
+           (r = sr_session_dev_add(d->session, sdi))!=SR_OK ||
+           (r = sr_session_datafeed_callback_add(d->session, datafeed, d))!=SR_OK){
+                fprintf(stderr, "error create session %s\n", sr_strerror(r));
+                device_close(d);
+                return NULL;
+        }
+        return d;
+}
+
+
+//start acquisition on first call, returns next logic packet length in bytes, 0 on end, -1 on error
+ssize_t device_next_block(device_t *d, const uint8_t **block){
+        if(!d->started){
+                int r = sr_session_start(d->session);
+                if(r!=SR_OK){
+                        fprintf(stderr, "error start acquisition %s\n", sr_strerror(r));
+                        return -1;
+                }
+                r = pthread_create(&d->thread, NULL, session_thread, d);
+                if(r!=0){
+                        fprintf(stderr, "error create thread %s\n", strerror(r));
+                        sr_session_stop(d->session);
+                        return -1;
+                }
+                d->started = true;
+        }
+        pthread_mutex_lock(&d->lock);
+        //release previous packet to libsigrok, packet published before first call is kept
+        if(d->delivered){
+                d->ready = false;
+                d->delivered = false;
+                pthread_cond_broadcast(&d->cond);
+        }
+        while(!d->ready && !d->ended && !d->error){
+                pthread_cond_wait(&d->cond, &d->lock);
+        }
+        ssize_t len = 0;
+        if(d->error){
+                len = -1;
+        } else if(d->ready){
+                *block = d->data;
+                len = d->length;
+                d->delivered = true;
+        }
+        pthread_mutex_unlock(&d->lock);
+        return len;
+}
+
+
+//stop acquisition and release device
+void device_close(device_t *d){
+        if(d==NULL){
+                return;
+        }
+        if(d->started){
+                pthread_mutex_lock(&d->lock);
+                d->stopping = true;
+                pthread_cond_broadcast(&d->cond);
+                pthread_mutex_unlock(&d->lock);
+                sr_session_stop(d->session);
+                pthread_join(d->thread, NULL);
+        }
+        if(d->session!=NULL){
+                sr_session_destroy(d->session);
+        }
+        if(d->sdi!=NULL){
+                sr_dev_close(d->sdi);
+        }
+        if(d->ctx!=NULL){
+                sr_exit(d->ctx);
+        }
+        pthread_cond_destroy(&d->cond);
+        pthread_mutex_destroy(&d->lock);
+        free(d->repack);
+        free(d);
+}
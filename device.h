@@ -0,0 +1,62 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+//live acquisition through libsigrok (built with HAVE_LIBSIGROK, make pwm-sigrok)
+//session runs in its own thread, logic datafeed packets are passed to decoders without copying:
+//datafeed callback publishes packet buffer and waits until decoder asks for next block,
+//so packet memory stays owned by libsigrok and only current block is valid
+//packets of other unitsize than enabled probes need are repacked into device buffer
+
+#define DEVICE_MAX_PROBES 32
+#define DEVICE_NAME_SIZE 64
+
+struct sr_context;
+struct sr_session;
+struct sr_dev_inst;
+
+typedef struct device {
+        struct sr_context *ctx;
+        struct sr_session *session;
+        struct sr_dev_inst *sdi;
+        pthread_t thread;//runs session event loop
+        bool started;
+
+        //device configuration
+        uint64_t samplerate;//Hz
+        int unitsize;
+        int probes_n;
+        char probe_names[DEVICE_MAX_PROBES][DEVICE_NAME_SIZE];
+        char name[DEVICE_NAME_SIZE];
+
+        //packet handoff between session thread and decoder
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        const uint8_t *data;
+        size_t length;
+        bool ready;//packet is published and not consumed yet
+        bool delivered;//published packet was returned to decoder
+        bool ended;
+        bool stopping;
+        bool error;
+        uint8_t *repack;//packet of other unitsize
+        size_t repack_size;
+} device_t;
+
+
+//open device of driver spec (driver[:conn=...]), apply config (key=value[:key=value]), returns NULL on error
+//config keys are sigrok-cli --config keys, e.g. samplerate=24m:limit_samples=10m, pattern for demo logic
+device_t *device_open(const char *spec, const char *config);
+
+//start acquisition on first call, returns next logic packet length in bytes, 0 on end, -1 on error
+//previous block is released to libsigrok
+ssize_t device_next_block(device_t *d, const uint8_t **block);
+
+//stop acquisition and release device
+void device_close(device_t *d);
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "pwm.h"
+#include "display.h"
+
+
+static void *display_thread(void *arg){
+        display_t *d = arg;
+        pthread_mutex_lock(&d->lock);
+        for(;;){
+                struct timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                ts.tv_sec += d->refresh_ms/1000;
+                ts.tv_nsec += (d->refresh_ms%1000)*1000000L;
+                if(ts.tv_nsec>=1000000000L){
+                        ts.tv_sec++;
+                        ts.tv_nsec -= 1000000000L;
+                }
+                while(!d->stop && pthread_cond_timedwait(&d->cond, &d->lock, &ts)==0){
+                }
+                if(d->stop){
+                        break;
+                }
+
+                __atomic_store_n(&d->request, 1, __ATOMIC_RELEASE);
+                while(!d->stop && __atomic_load_n(&d->request, __ATOMIC_ACQUIRE)){
+                        pthread_cond_wait(&d->cond, &d->lock);
+                }
+                if(d->stop){
+                        break;
+                }
+
+                //snapshot stays unchanged until next request
+                pthread_mutex_unlock(&d->lock);
+                context_t *ctx = d->snapshot;
+                printf("\x1B[1;1H");
+                printf("%lld\n", (long long)ctx->line_num);
+                dump_results(ctx, d->samplerate, true);
+                fflush(stdout);
+                pthread_mutex_lock(&d->lock);
+        }
+        pthread_mutex_unlock(&d->lock);
+        return NULL;
+}
+
+
+//start display thread, returns NULL on error
+display_t *display_start(int refresh_ms, int samplerate){
+        display_t *d = calloc(1, sizeof(display_t));
+        if(d==NULL){
+                fprintf(stderr, "error allocate display\n");
+                return NULL;
+        }
+        d->snapshot = malloc(sizeof(context_t));
+        if(d->snapshot==NULL){
+                fprintf(stderr, "error allocate display\n");
+                free(d);
+                return NULL;
+        }
+        d->refresh_ms = refresh_ms;
+        d->samplerate = samplerate;
+
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&d->cond, &attr);
+        pthread_condattr_destroy(&attr);
+        pthread_mutex_init(&d->lock, NULL);
+
+        int r = pthread_create(&d->thread, NULL, display_thread, d);
+        if(r!=0){
+                fprintf(stderr, "error create display thread %s\n", strerror(r));
+                pthread_cond_destroy(&d->cond);
+                pthread_mutex_destroy(&d->lock);
+                free(d->snapshot);
+                free(d);
+                return NULL;
+        }
+        return d;
+}
+
+
+//stop display thread and release display
+void display_stop(display_t *d){
+        if(d==NULL){
+                return;
+        }
+        pthread_mutex_lock(&d->lock);
+        d->stop = true;
+        pthread_cond_signal(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+        pthread_join(d->thread, NULL);
+        pthread_cond_destroy(&d->cond);
+        pthread_mutex_destroy(&d->lock);
+        free(d->snapshot);
+        free(d);
+}
+
+
+//copy decoded state to snapshot and wake display thread
+void display_publish(display_t *d, context_t *ctx){
+        memcpy(d->snapshot, ctx, sizeof(context_t));
+        pthread_mutex_lock(&d->lock);
+        __atomic_store_n(&d->request, 0, __ATOMIC_RELEASE);
+        pthread_cond_signal(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+}
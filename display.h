@@ -0,0 +1,40 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+struct context;
+
+//live terminal display, rendered by own thread
+//display thread raises request, decode loop copies its state into snapshot and clears request,
+//so snapshot is owned by decode loop only while request is set and terminal output never blocks decoding
+typedef struct display {
+        int refresh_ms;
+        int samplerate;//kHz
+
+        struct context *snapshot;
+        int request;//snapshot wanted, set by display thread, cleared by publisher
+        bool stop;
+
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        pthread_t thread;
+} display_t;
+
+
+//start display thread, returns NULL on error
+display_t *display_start(int refresh_ms, int samplerate);
+
+//stop display thread and release display
+void display_stop(display_t *d);
+
+//display waits for snapshot? cheap check for decode loop
+static inline bool display_wanted(display_t *d){
+        return d!=NULL && __atomic_load_n(&d->request, __ATOMIC_ACQUIRE);
+}
+
+//copy decoded state to snapshot and wake display thread
+void display_publish(display_t *d, struct context *ctx);
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dshot.h"
+#include "edges.h"
+
+
+//unpack 16 received bits, returns 0 if crc is valid
+int dshot_unpack(uint16_t bits, dshot_frame_t *frame){
+        uint16_t value = bits>>4;
+        frame->throttle = value>>1;
+        frame->telemetry = value & 1;
+        frame->crc = bits & 0x0F;
+        return ((value ^ (value>>4) ^ (value>>8)) & 0x0F)!=frame->crc;
+}
+
+
+//init statistics with averaging window, returns 0 on success
+int init_dshot_stats(dshot_stats_t *stats, int window_size){
+        memset(stats, 0, sizeof(dshot_stats_t));
+        stats->last_frame_time = -1;
+        if(init_average(&stats->interval, window_size)){
+                return 1;
+        }
+        if(init_average(&stats->throttle, window_size)){
+                free_average(&stats->interval);
+                return 1;
+        }
+        return 0;
+}
+
+
+void free_dshot_stats(dshot_stats_t *stats){
+        free_average(&stats->interval);
+        free_average(&stats->throttle);
+}
+
+
+//account frame which started at time
+void dshot_stats_update(dshot_stats_t *stats, uint16_t bits, int64_t time){
+        dshot_frame_t frame;
+        if(dshot_unpack(bits, &frame)){
+                stats->crc_errors++;
+                return;
+        }
+        stats->frames++;
+        if(frame.telemetry){
+                stats->telemetry++;
+        }
+        if(frame.throttle<DSHOT_MIN_THROTTLE){
+                stats->commands++;
+        } else {
+                update_average(&stats->throttle, frame.throttle);
+        }
+        if(stats->last_frame_time>=0){
+                update_average(&stats->interval, time_delta(time, stats->last_frame_time));
+        }
+        stats->last_frame_time = time;
+        stats->last = frame;
+}
+
+
+//print statistics, samplerate in kHz
+void dump_dshot_stats(dshot_stats_t *stats, int samplerate){
+        average_data_t *interval = &stats->interval;
+        average_data_t *throttle = &stats->throttle;
+        printf("frames:%lld crc_errors:%d bit_errors:%d commands:%d telemetry:%d", stats->frames, stats->crc_errors,
+               stats->bit_errors, stats->commands, stats->telemetry);
+        if(!average_has_enough_data(interval)){
+                printf(" interval: no data");
+        } else if(samplerate>0){
+                double ms = 1.0/samplerate;
+                printf(" rate:%.2f Hz interval:%.3f ms jitter:%.1f us", 1000.0/(interval->average*ms),
+                       interval->average*ms, interval->rmsd*ms*1000);
+        }
+        printf("\n");
+        if(stats->frames==0){
+                return;
+        }
+        printf("throttle:%d telemetry:%d", stats->last.throttle, stats->last.telemetry);
+        if(!average_has_enough_data(throttle)){
+                printf(" avg: no data");
+        } else {
+                printf(" avg:%.1f median:%d min:%d max:%d", throttle->average, throttle->median,
+                       throttle->min_value, throttle->max_value);
+        }
+        printf("\n");
+}
@@ -0,0 +1,49 @@
+#ifndef DSHOT_H
+#define DSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "average.h"
+
+//dshot frame: 16 bits msb first, 11 bit throttle, telemetry request, 4 bit crc of first 12 bits
+//every bit starts with rising edge, '1' is high for 3/4 of bit period, '0' for 3/8, line is low between frames
+#define DSHOT_FRAME_BITS 16
+//throttle values below are commands (0 is disarm), 48..2047 is throttle
+#define DSHOT_MIN_THROTTLE 48
+#define DSHOT_MAX_THROTTLE 2047
+
+typedef struct dshot_frame {
+        uint16_t throttle;
+        bool telemetry;
+        uint8_t crc;
+} dshot_frame_t;
+
+//per-probe frame statistics
+typedef struct dshot_stats {
+        long long frames;//frames with valid crc
+        int crc_errors;
+        int bit_errors;//frames broken by pulse or gap out of bit timing
+        int commands;//valid frames with command instead of throttle
+        int telemetry;//valid frames with telemetry request
+        int64_t last_frame_time;//start of last valid frame, -1 before first frame
+        average_data_t interval;//samples between valid frame starts
+        average_data_t throttle;//throttle values of valid non-command frames
+        dshot_frame_t last;
+} dshot_stats_t;
+
+
+//unpack 16 received bits, returns 0 if crc is valid
+int dshot_unpack(uint16_t bits, dshot_frame_t *frame);
+
+//init statistics with averaging window, returns 0 on success
+int init_dshot_stats(dshot_stats_t *stats, int window_size);
+void free_dshot_stats(dshot_stats_t *stats);
+
+//account frame which started at time
+void dshot_stats_update(dshot_stats_t *stats, uint16_t bits, int64_t time);
+
+//print statistics, samplerate in kHz
+void dump_dshot_stats(dshot_stats_t *stats, int samplerate);
+
+#endif
@@ -0,0 +1,344 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "edgeindex.h"
+#include "varint.h"
+#include "writeat.h"
+
+
+//create index file, returns NULL on error
+edge_index_writer_t *edge_index_create(const char *path, uint32_t probe_mask){
+        edge_index_writer_t *w = calloc(1, sizeof(edge_index_writer_t));
+        if(w==NULL){
+                fprintf(stderr, "error allocate edge index\n");
+                return NULL;
+        }
+        w->probe_mask = probe_mask;
+        for(int i=0;i<EDGE_INDEX_PROBES;i++){
+                if(probe_mask & (1U<<i)){
+                        w->channels[i].buffer = malloc(EDGE_INDEX_BLOCK_SIZE);
+                        if(w->channels[i].buffer==NULL){
+                                fprintf(stderr, "error allocate edge index\n");
+                                for(int j=0;j<i;j++){
+                                        free(w->channels[j].buffer);
+                                }
+                                free(w);
+                                return NULL;
+                        }
+                }
+        }
+        w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(w->fd<0){
+                fprintf(stderr, "error open %s %s\n", path, strerror(errno));
+                for(int i=0;i<EDGE_INDEX_PROBES;i++){
+                        free(w->channels[i].buffer);
+                }
+                free(w);
+                return NULL;
+        }
+        pthread_mutex_init(&w->lock, NULL);
+        w->offset = sizeof(edge_index_header_t);
+        return w;
+}
+
+
+//append collected block of probe to file and seek table
+static void flush_channel(edge_index_writer_t *w, int probe_idx){
+        edge_index_channel_t *ch = &w->channels[probe_idx];
+        edge_index_block_t block;
+        memset(&block, 0, sizeof(block));
+        block.probe = probe_idx;
+        block.edges = ch->edges;
+        block.size = ch->size;
+        block.level = ch->level;
+        block.first_time = ch->first_time;
+        block.last_time = ch->last_time;
+
+        pthread_mutex_lock(&w->lock);
+        if(w->blocks_n>=w->blocks_capacity){
+                uint32_t capacity = w->blocks_capacity ? w->blocks_capacity*2 : 1024;
+                edge_index_block_t *blocks = realloc(w->blocks, capacity*sizeof(edge_index_block_t));
+                if(blocks==NULL){
+                        w->error = ENOMEM;
+                } else {
+                        w->blocks = blocks;
+                        w->blocks_capacity = capacity;
+                }
+        }
+        if(!w->error){
+                block.offset = w->offset+sizeof(block);
+                int error = write_at(w->fd, &block, sizeof(block), w->offset);
+                if(!error){
+                        error = write_at(w->fd, ch->buffer, ch->size, block.offset);
+                }
+                w->error = error;
+                w->offset = block.offset+ch->size;
+                w->blocks[w->blocks_n++] = block;
+        }
+        pthread_mutex_unlock(&w->lock);
+
+        //level after odd number of edges is inverted
+        ch->level ^= ch->edges & 1;
+        ch->edges = 0;
+        ch->size = 0;
+}
+
+
+//add edges of one decoder, edges of every probe must come in time order
+void edge_index_add(edge_index_writer_t *w, const edge_t *edges, int n){
+        for(int i=0;i<n;i++){
+                const edge_t *edge = &edges[i];
+                edge_index_channel_t *ch = &w->channels[edge->probe];
+                if(ch->buffer==NULL){
+                        continue;
+                }
+                if(ch->edges==0){
+                        ch->first_time = edge->time;
+                        ch->last_time = edge->time;
+                }
+                uint8_t *p = put_varint(ch->buffer+ch->size, edge->time-ch->last_time);
+                ch->size = p-ch->buffer;
+                ch->last_time = edge->time;
+                ch->edges++;
+                if(ch->edges>=EDGE_INDEX_BLOCK_EDGES){
+                        flush_channel(w, edge->probe);
+                }
+        }
+}
+
+
+//flush blocks, write seek table and header, returns 0 on success
+int edge_index_close(edge_index_writer_t *w, uint64_t samples, uint64_t samplerate, int unitsize){
+        for(int i=0;i<EDGE_INDEX_PROBES;i++){
+                if(w->channels[i].edges>0){
+                        flush_channel(w, i);
+                }
+        }
+        edge_index_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, EDGE_INDEX_MAGIC, sizeof(header.magic));
+        header.version = EDGE_INDEX_VERSION;
+        header.unitsize = unitsize;
+        header.samplerate = samplerate;
+        header.samples = samples;
+        header.probe_mask = w->probe_mask;
+        header.blocks = w->blocks_n;
+        header.seek_offset = w->offset;
+        if(!w->error){
+                w->error = write_at(w->fd, w->blocks, (size_t)w->blocks_n*sizeof(edge_index_block_t), w->offset);
+        }
+        if(!w->error){
+                w->error = write_at(w->fd, &header, sizeof(header), 0);
+        }
+        if(close(w->fd)!=0 && !w->error){
+                w->error = errno;
+        }
+        int error = w->error;
+        if(error){
+                fprintf(stderr, "error write edge index %s\n", strerror(error));
+        }
+        for(int i=0;i<EDGE_INDEX_PROBES;i++){
+                free(w->channels[i].buffer);
+        }
+        pthread_mutex_destroy(&w->lock);
+        free(w->blocks);
+        free(w);
+        return error!=0;
+}
+
+
+//open index file, returns 0 on success
+int edge_index_open(edge_index_reader_t *r, const char *path){
+        memset(r, 0, sizeof(edge_index_reader_t));
+        r->fd = open(path, O_RDONLY);
+        if(r->fd<0){
+                fprintf(stderr, "error open %s %s\n", path, strerror(errno));
+                return 1;
+        }
+        struct stat st;
+        if(fstat(r->fd, &st)!=0 || (size_t)st.st_size<sizeof(edge_index_header_t)){
+                fprintf(stderr, "error read edge index %s\n", path);
+                edge_index_close_reader(r);
+                return 1;
+        }
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+        if(map==MAP_FAILED){
+                fprintf(stderr, "error map %s %s\n", path, strerror(errno));
+                edge_index_close_reader(r);
+                return 1;
+        }
+        r->map = map;
+        r->map_size = st.st_size;
+        memcpy(&r->header, r->map, sizeof(edge_index_header_t));
+        edge_index_header_t *h = &r->header;
+        if(memcmp(h->magic, EDGE_INDEX_MAGIC, sizeof(h->magic))!=0 || h->version!=EDGE_INDEX_VERSION){
+                fprintf(stderr, "%s is not edge index\n", path);
+                edge_index_close_reader(r);
+                return 1;
+        }
+        if(h->seek_offset>r->map_size || (r->map_size-h->seek_offset)/sizeof(edge_index_block_t)<h->blocks){
+                fprintf(stderr, "edge index %s is truncated\n", path);
+                edge_index_close_reader(r);
+                return 1;
+        }
+        //seek table follows varint payloads, so it is not aligned in file, +1 keeps empty table allocated
+        r->seek = malloc((size_t)h->blocks*sizeof(edge_index_block_t)+1);
+        if(r->seek==NULL){
+                fprintf(stderr, "error allocate edge index\n");
+                edge_index_close_reader(r);
+                return 1;
+        }
+        memcpy(r->seek, r->map+h->seek_offset, (size_t)h->blocks*sizeof(edge_index_block_t));
+        for(uint32_t i=0;i<h->blocks;i++){
+                const edge_index_block_t *b = &r->seek[i];
+                if(b->probe>=EDGE_INDEX_PROBES || b->offset>r->map_size || r->map_size-b->offset<b->size){
+                        fprintf(stderr, "edge index %s is corrupted\n", path);
+                        edge_index_close_reader(r);
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+
+//start decoding block of cursor
+static void load_block(edge_index_reader_t *r, edge_index_cursor_t *c){
+        const edge_index_block_t *b = &r->seek[c->blocks[c->block]];
+        c->p = r->map+b->offset;
+        c->left = b->edges;
+        c->time = b->first_time;
+        c->level = b->level;
+}
+
+
+//move cursor to next edge, time is INT64_MAX at end
+static void advance(edge_index_reader_t *r, edge_index_cursor_t *c){
+        while(c->left==0){
+                if(c->block+1>=c->blocks_n){
+                        c->time = INT64_MAX;
+                        return;
+                }
+                c->block++;
+                load_block(r, c);
+        }
+        uint64_t delta;
+        c->p = get_varint(c->p, &delta);
+        c->time += delta;
+        c->level ^= 1;
+        c->left--;
+}
+
+
+//position probes of mask at start_time, returns 0 on success
+int edge_index_seek(edge_index_reader_t *r, uint32_t mask, int64_t start_time){
+        free(r->block_lists);
+        r->block_lists = malloc((r->header.blocks+1)*sizeof(uint32_t));
+        if(r->block_lists==NULL){
+                fprintf(stderr, "error allocate edge index\n");
+                return 1;
+        }
+        r->mask = mask & r->header.probe_mask;
+        r->start_time = start_time;
+        r->start_high = 0;
+        uint32_t pos = 0;
+        for(int i=0;i<EDGE_INDEX_PROBES;i++){
+                edge_index_cursor_t *c = &r->cursors[i];
+                memset(c, 0, sizeof(edge_index_cursor_t));
+                c->time = INT64_MAX;
+                if(!(r->mask & (1U<<i))){
+                        continue;
+                }
+                c->blocks = r->block_lists+pos;
+                for(uint32_t b=0;b<r->header.blocks;b++){
+                        if(r->seek[b].probe==(uint32_t)i){
+                                r->block_lists[pos++] = b;
+                                c->blocks_n++;
+                        }
+                }
+                if(c->blocks_n==0){
+                        continue;
+                }
+                //first block which ends at or after start
+                uint32_t lo = 0, hi = c->blocks_n-1;
+                while(lo<hi){
+                        uint32_t mid = (lo+hi)/2;
+                        if(r->seek[c->blocks[mid]].last_time<start_time){
+                                lo = mid+1;
+                        } else {
+                                hi = mid;
+                        }
+                }
+                c->block = lo;
+                load_block(r, c);
+                int level = c->level;
+                advance(r, c);
+                //edges up to start define level at start
+                while(c->time<=start_time){
+                        level = c->level;
+                        advance(r, c);
+                }
+                if(level){
+                        r->start_high |= 1U<<i;
+                }
+        }
+        return 0;
+}
+
+
+//read edges before until, in (time, probe) order, returns number of edges (at most max_edges)
+int edge_index_read(edge_index_reader_t *r, int64_t until, edge_t *edges, int max_edges){
+        int n = 0;
+        //probes already high at start are reported as rising edges
+        while(r->start_high && n<max_edges && r->start_time<until){
+                int probe_idx = __builtin_ctz(r->start_high);
+                edges[n].time = r->start_time;
+                edges[n].probe = probe_idx;
+                edges[n].value = 1;
+                n++;
+                r->start_high &= r->start_high-1;
+        }
+        while(n<max_edges){
+                edge_index_cursor_t *best = NULL;
+                int best_idx = 0;
+                uint32_t probes = r->mask;
+                while(probes){
+                        int probe_idx = __builtin_ctz(probes);
+                        edge_index_cursor_t *c = &r->cursors[probe_idx];
+                        if(best==NULL || c->time<best->time){
+                                best = c;
+                                best_idx = probe_idx;
+                        }
+                        probes &= probes-1;
+                }
+                if(best==NULL || best->time>=until){
+                        break;
+                }
+                edges[n].time = best->time;
+                edges[n].probe = best_idx;
+                edges[n].value = best->level;
+                n++;
+                advance(r, best);
+        }
+        return n;
+}
+
+
+void edge_index_close_reader(edge_index_reader_t *r){
+        if(r->map!=NULL){
+                munmap((void *)r->map, r->map_size);
+        }
+        if(r->fd>=0){
+                close(r->fd);
+        }
+        free(r->seek);
+        free(r->block_lists);
+        memset(r, 0, sizeof(edge_index_reader_t));
+        r->fd = -1;
+}
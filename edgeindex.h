@@ -0,0 +1,119 @@
+#ifndef EDGEINDEX_H
+#define EDGEINDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "edges.h"
+
+//persistent edge index: transitions of every probe, for re-analysis without scanning samples
+//file: header, blocks of one probe (block header + varint time deltas), seek table of all blocks
+//every probe starts at low level and every edge toggles it, so only edge times are stored
+//block holds up to EDGE_INDEX_BLOCK_EDGES edges, seek table entry per block allows start at any time
+//all fields are little-endian
+#define EDGE_INDEX_MAGIC "PWMEDGIX"
+#define EDGE_INDEX_VERSION 1
+#define EDGE_INDEX_PROBES 32
+#define EDGE_INDEX_BLOCK_EDGES 4096
+//varint of 64-bit delta takes at most 10 bytes
+#define EDGE_INDEX_BLOCK_SIZE (EDGE_INDEX_BLOCK_EDGES*10)
+
+typedef struct edge_index_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t unitsize;
+        uint64_t samplerate;//Hz
+        uint64_t samples;//indexed samples
+        uint32_t probe_mask;
+        uint32_t blocks;//seek table entries
+        uint64_t seek_offset;//seek table position
+        uint8_t reserved[16];
+} edge_index_header_t;
+
+//block header in file, same data is kept in seek table
+typedef struct edge_index_block {
+        uint32_t probe;
+        uint32_t edges;
+        uint32_t size;//varint payload bytes
+        uint32_t level;//probe level before first edge
+        int64_t first_time;
+        int64_t last_time;
+        uint64_t offset;//payload position in file
+} edge_index_block_t;
+
+_Static_assert(sizeof(edge_index_header_t)==64, "edge index header size");
+_Static_assert(sizeof(edge_index_block_t)==40, "edge index block size");
+
+//per-probe block being collected
+typedef struct edge_index_channel {
+        uint8_t *buffer;
+        uint32_t size;
+        uint32_t edges;
+        uint32_t level;//level before first edge of block
+        int64_t first_time;
+        int64_t last_time;
+} edge_index_channel_t;
+
+//index writer, channels are owned by decoders of their probes, file appends are locked
+typedef struct edge_index_writer {
+        int fd;
+        uint32_t probe_mask;
+        edge_index_channel_t channels[EDGE_INDEX_PROBES];
+
+        pthread_mutex_t lock;
+        uint64_t offset;//file end
+        edge_index_block_t *blocks;
+        uint32_t blocks_n;
+        uint32_t blocks_capacity;
+        int error;//errno of failed write
+} edge_index_writer_t;
+
+//probe cursor of reader
+typedef struct edge_index_cursor {
+        uint32_t *blocks;//seek table entries of probe
+        uint32_t blocks_n;
+        uint32_t block;//current block
+        const uint8_t *p;//next varint
+        uint32_t left;//edges left in current block
+        int64_t time;//time of next edge, INT64_MAX at end
+        int level;//level after next edge
+} edge_index_cursor_t;
+
+//memory mapped index reader
+typedef struct edge_index_reader {
+        int fd;
+        const uint8_t *map;
+        size_t map_size;
+        edge_index_header_t header;
+        edge_index_block_t *seek;//copy of seek table
+        uint32_t mask;//probes being read
+        edge_index_cursor_t cursors[EDGE_INDEX_PROBES];
+        uint32_t *block_lists;
+        int64_t start_time;
+        uint32_t start_high;//probes high at start_time, reported as edges at start_time
+} edge_index_reader_t;
+
+
+//create index file, returns NULL on error
+edge_index_writer_t *edge_index_create(const char *path, uint32_t probe_mask);
+
+//add edges of one decoder, edges of every probe must come in time order
+void edge_index_add(edge_index_writer_t *w, const edge_t *edges, int n);
+
+//flush blocks, write seek table and header, returns 0 on success
+int edge_index_close(edge_index_writer_t *w, uint64_t samples, uint64_t samplerate, int unitsize);
+
+
+//open index file, returns 0 on success
+int edge_index_open(edge_index_reader_t *r, const char *path);
+
+//position probes of mask at start_time, returns 0 on success
+int edge_index_seek(edge_index_reader_t *r, uint32_t mask, int64_t start_time);
+
+//read edges before until, in (time, probe) order, returns number of edges (at most max_edges)
+int edge_index_read(edge_index_reader_t *r, int64_t until, edge_t *edges, int max_edges);
+
+void edge_index_close_reader(edge_index_reader_t *r);
+
+#endif
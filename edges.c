@@ -0,0 +1,100 @@
+#include <string.h>
+
+#include "edges.h"
+
+//unitsize 1, 2, 4 bit patterns to repeat one sample over 64-bit word
+#define REPEAT_8  0x0101010101010101ULL
+#define REPEAT_16 0x0001000100010001ULL
+#define REPEAT_32 0x0000000100000001ULL
+
+
+//init detector, all probes start at low level
+void init_edge_detector(edge_detector_t *det, uint32_t mask){
+        det->last_sample = 0;
+        det->mask = mask;
+}
+
+
+//emit edges for all watched probes changed in sample
+static inline int emit_edges(edge_detector_t *det, uint32_t sample, int64_t time, edge_t *edges, int count){
+        uint32_t changed = (sample ^ det->last_sample) & det->mask;
+        while(changed){
+                int probe = __builtin_ctz(changed);
+                edges[count].time = time;
+                edges[count].probe = probe;
+                edges[count].value = (sample>>probe) & 1;
+                count++;
+                changed &= changed-1;
+        }
+        det->last_sample = sample;
+        return count;
+}
+
+
+//extraction loop for fixed sample width, inlined with constant unitsize into each specialization
+static inline __attribute__((always_inline))
+int extract_edges_width(edge_detector_t *det, const uint8_t *block, size_t len, size_t *pos,
+                        int64_t base_time, edge_t *edges, int max_edges, const int unitsize){
+        const uint64_t repeat = unitsize==1 ? REPEAT_8 : unitsize==2 ? REPEAT_16 : REPEAT_32;
+        const uint32_t width_mask = unitsize==4 ? 0xFFFFFFFF : (1U<<(unitsize*8))-1;
+        const int per_word = 8/unitsize;
+        int count = 0;
+        size_t i = *pos;
+        uint64_t mask = (det->mask & width_mask) * repeat;
+
+        while(i<len && count+32<=max_edges){
+                //skip 8 bytes at once while watched probes do not change
+                uint64_t pattern = (det->last_sample & width_mask) * repeat;
+                while(i+per_word<=len){
+                        uint64_t w;
+                        memcpy(&w, block+i*unitsize, sizeof(w));
+                        uint64_t diff = (w ^ pattern) & mask;
+                        if(diff){
+                                //little-endian load: lowest set byte is in the first changed sample
+                                i += (__builtin_ctzll(diff)>>3)/unitsize;
+                                break;
+                        }
+                        i += per_word;
+                }
+                if(i>=len){
+                        break;
+                }
+                count = emit_edges(det, load_sample(block+i*unitsize, unitsize), base_time+(int64_t)i, edges, count);
+                i++;
+        }
+        *pos = i;
+        return count;
+}
+
+
+static int extract_edges_u8(edge_detector_t *det, const uint8_t *block, size_t len, size_t *pos,
+                            int64_t base_time, edge_t *edges, int max_edges){
+        return extract_edges_width(det, block, len, pos, base_time, edges, max_edges, 1);
+}
+
+static int extract_edges_u16(edge_detector_t *det, const uint8_t *block, size_t len, size_t *pos,
+                             int64_t base_time, edge_t *edges, int max_edges){
+        return extract_edges_width(det, block, len, pos, base_time, edges, max_edges, 2);
+}
+
+static int extract_edges_u32(edge_detector_t *det, const uint8_t *block, size_t len, size_t *pos,
+                             int64_t base_time, edge_t *edges, int max_edges){
+        return extract_edges_width(det, block, len, pos, base_time, edges, max_edges, 4);
+}
+
+
+//scan block of samples (unitsize 1, 2 or 4 bytes) from sample *pos, block[0] has time base_time
+//len and *pos are in samples
+//stops at block end or when edges buffer is (almost) full
+//returns number of extracted edges, *pos is advanced past the scanned samples
+int extract_edges(edge_detector_t *det, int unitsize, const uint8_t *block, size_t len, size_t *pos,
+                  int64_t base_time, edge_t *edges, int max_edges){
+        switch(unitsize){
+        case 1:
+                return extract_edges_u8(det, block, len, pos, base_time, edges, max_edges);
+        case 2:
+                return extract_edges_u16(det, block, len, pos, base_time, edges, max_edges);
+        default:
+                return extract_edges_u32(det, block, len, pos, base_time, edges, max_edges);
+        }
+}
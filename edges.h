@@ -0,0 +1,56 @@
+#ifndef EDGES_H
+#define EDGES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+
+//edges buffer size for one extraction pass
+#define EDGE_BUFFER_SIZE 65536
+
+//sample times are 64-bit from start of capture, so continuous capture never wraps
+//widths, periods and intervals are kept as 32-bit deltas
+
+//delta of two sample times, saturated for gaps over INT_MAX samples (about 90 s at 24 MHz)
+static inline int time_delta(int64_t later, int64_t earlier){
+        int64_t delta = later-earlier;
+        return delta>INT_MAX ? INT_MAX : (int)delta;
+}
+
+//logic level transition on one probe
+typedef struct edge {
+        int64_t time;
+        uint8_t probe;
+        uint8_t value;
+} edge_t;
+
+//transition extraction state
+typedef struct edge_detector {
+        uint32_t last_sample;
+        uint32_t mask;//probes to watch
+} edge_detector_t;
+
+
+//init detector, all probes start at low level
+void init_edge_detector(edge_detector_t *det, uint32_t mask);
+
+//read little-endian sample of unitsize bytes
+static inline uint32_t load_sample(const uint8_t *p, int unitsize){
+        switch(unitsize){
+        case 1:
+                return p[0];
+        case 2:
+                return p[0] | (p[1]<<8);
+        default:
+                return p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24);
+        }
+}
+
+//scan block of samples (unitsize 1, 2 or 4 bytes) from sample *pos, block[0] has time base_time
+//len and *pos are in samples
+//stops at block end or when edges buffer is (almost) full
+//returns number of extracted edges, *pos is advanced past the scanned samples
+int extract_edges(edge_detector_t *det, int unitsize, const uint8_t *block, size_t len, size_t *pos,
+                  int64_t base_time, edge_t *edges, int max_edges);
+
+#endif
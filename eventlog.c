@@ -0,0 +1,396 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "eventlog.h"
+#include "dshot.h"
+
+//merged buffers, one per decoder thread
+#define EVENT_MAX_BUFFERS 32
+
+
+//grow events array, returns false if buffer can not grow
+bool event_buffer_grow(event_buffer_t *buf){
+        int capacity = buf->capacity ? buf->capacity*2 : 1024;
+        dump_event_t *events = realloc(buf->events, capacity*sizeof(dump_event_t));
+        if(events==NULL){
+                buf->dropped++;
+                return false;
+        }
+        buf->events = events;
+        buf->capacity = capacity;
+        return true;
+}
+
+
+//append sbus packet event with copy of packet bytes
+void event_buffer_add_packet(event_buffer_t *buf, int probe_idx, int64_t time, uint8_t *packet, int length){
+        if(buf->data_size+length>buf->data_capacity){
+                int capacity = buf->data_capacity ? buf->data_capacity : 4096;
+                while(buf->data_size+length>capacity){
+                        capacity *= 2;
+                }
+                uint8_t *data = realloc(buf->data, capacity);
+                if(data==NULL){
+                        buf->dropped++;
+                        return;
+                }
+                buf->data = data;
+                buf->data_capacity = capacity;
+        }
+        dump_event_t *event = event_buffer_add(buf, EVENT_SBUS_PACKET, probe_idx, time);
+        if(event==NULL){
+                return;
+        }
+        event->sbus.offset = buf->data_size;
+        event->sbus.length = length;
+        //empty packet is still dumped, but has no bytes and buffer may not be allocated yet
+        if(length==0){
+                return;
+        }
+        memcpy(buf->data+buf->data_size, packet, length);
+        buf->data_size += length;
+}
+
+
+void event_buffer_clear(event_buffer_t *buf){
+        buf->count = 0;
+        buf->data_size = 0;
+}
+
+
+void event_buffer_free(event_buffer_t *buf){
+        free(buf->events);
+        free(buf->data);
+        memset(buf, 0, sizeof(event_buffer_t));
+}
+
+
+
+void decode_sbus_packet(FILE *f, uint8_t *packet, size_t len){        
+    if(len!=25 || packet[0]!=0xF0){
+        fprintf(f, "not SBus packet\n");
+        return;
+    }
+    (void)len;
+    uint16_t current = 0;
+    int bits = 0;
+    int channel = 0;
+    for(int i=1;i<23;i++){
+        uint8_t b = packet[i];
+        for(int j=0;j<8;j++){
+            fprintf(f, "%d", b&1);             
+            bits++;
+            current >>= 1;
+            current |= (b&1)?0x0400:0;
+            b >>= 1;
+            if(bits==11) {
+                    fprintf(f, " [%4d] ", current);
+                    bits = 0;
+                    current = 0;
+                    channel++;
+                    if(channel==8){ 
+                            fprintf(f,"\n");
+                    }
+            }
+            
+            /*if(b&1){
+                current |= 0x400;
+                //current |= 1;
+            }
+            b >>= 1;
+            current >>= 1;
+            //current <<= 1;
+            bits++;
+            if(bits==11) {
+                fprintf(f, "%4.4x ", current);
+                bits = 0;
+                current = 0;
+            }*/
+        }
+    }
+    fprintf(f, "\n");
+    uint8_t b = packet[23];
+    fprintf(f, "d17:%d d18:%d loss:%d f/s:%d\n", (b & 0x80)>>7, (b & 0x40)>>6, (b & 0x20)>>5, (b & 0x10)>>4);
+}
+
+
+//write one dump event in text form
+void write_dump_event(FILE *f, event_buffer_t *buf, dump_event_t *event){
+        if(event->type==EVENT_PULSE){
+                fprintf(f, "%d,%lld,%lld,%d,%d,%d,%d,%f,%f,%f,%f\n",
+                        event->probe, (long long)event->time+1, (long long)event->time,
+                        event->pulse.width, event->pulse.period,
+                        event->pulse.width_median, event->pulse.period_median,
+                        event->pulse.width_average, event->pulse.period_average,
+                        event->pulse.width_rmsd, event->pulse.period_rmsd);
+        } else if(event->type==EVENT_SBUS_PACKET){
+                uint8_t *packet = buf->data+event->sbus.offset;
+                fprintf(f, "t:%8.8llx p:%d data:", (unsigned long long)event->time, event->probe);
+                for(int i=0;i<event->sbus.length;i++){
+                        fprintf(f, "%2.2x ", packet[i]);
+                }
+                fprintf(f, "\n");
+                decode_sbus_packet(f, packet, event->sbus.length);
+        } else if(event->type==EVENT_DSHOT_FRAME){
+                dshot_frame_t frame;
+                int crc_error = dshot_unpack(event->dshot.bits, &frame);
+                fprintf(f, "t:%8.8llx p:%d dshot:%4.4x throttle:%d telemetry:%d crc:%s\n", (unsigned long long)event->time, event->probe,
+                        event->dshot.bits, frame.throttle, frame.telemetry, crc_error ? "error" : "ok");
+        }
+}
+
+
+//event a goes before event b in dump file?
+static inline bool event_before(dump_event_t *a, dump_event_t *b){
+        return a->time<b->time || (a->time==b->time && a->probe<b->probe);
+}
+
+
+//sort events of buffer in (time, probe) order
+//sbus bytes are decoded at the next edge of their probe, so events are only slightly out of order
+static void event_buffer_sort(event_buffer_t *buf){
+        for(int i=1;i<buf->count;i++){
+                if(!event_before(&buf->events[i], &buf->events[i-1])){
+                        continue;
+                }
+                dump_event_t event = buf->events[i];
+                int j = i;
+                while(j>0 && event_before(&event, &buf->events[j-1])){
+                        buf->events[j] = buf->events[j-1];
+                        j--;
+                }
+                buf->events[j] = event;
+        }
+}
+
+
+//write events of several buffers, merged in (time, probe) order, to text dump and/or binary log
+void write_dump_events(FILE *f, event_log_t *log, event_buffer_t **buffers, int buffers_n){
+        int pos[EVENT_MAX_BUFFERS] = {0};
+        for(int i=0;i<buffers_n;i++){
+                event_buffer_sort(buffers[i]);
+        }
+        for(;;){
+                int best = -1;
+                dump_event_t *best_event = NULL;
+                for(int i=0;i<buffers_n;i++){
+                        if(pos[i]>=buffers[i]->count){
+                                continue;
+                        }
+                        dump_event_t *event = &buffers[i]->events[pos[i]];
+                        if(best_event==NULL || event_before(event, best_event)){
+                                best = i;
+                                best_event = event;
+                        }
+                }
+                if(best<0){
+                        return;
+                }
+                if(best_event->type==EVENT_TRIGGER){
+                        pos[best]++;
+                        continue;
+                }
+                if(f!=NULL){
+                        write_dump_event(f, buffers[best], best_event);
+                }
+                if(log!=NULL){
+                        event_log_write(log, buffers[best], best_event);
+                }
+                pos[best]++;
+        }
+}
+
+
+
+
+//write out buffered records
+static void event_log_flush(event_log_t *log){
+        size_t pos = 0;
+        while(pos<log->size && !log->error){
+                ssize_t r = write(log->fd, log->buffer+pos, log->size-pos);
+                if(r<0){
+                        if(errno==EINTR){
+                                continue;
+                        }
+                        log->error = errno;
+                        break;
+                }
+                pos += r;
+        }
+        log->size = 0;
+}
+
+
+static event_record_t *event_log_record(event_log_t *log){
+        if(log->size+sizeof(event_record_t)>EVENT_LOG_BUFFER_SIZE){
+                event_log_flush(log);
+        }
+        event_record_t *record = (event_record_t *)(log->buffer+log->size);
+        log->size += sizeof(event_record_t);
+        memset(record, 0, sizeof(event_record_t));
+        return record;
+}
+
+
+//create binary log file and write header, returns NULL on error
+event_log_t *event_log_open(const char *path, uint64_t samplerate, uint32_t probe_mask, int protocol, const uint8_t *protocols){
+        event_log_t *log = calloc(1, sizeof(event_log_t));
+        if(log==NULL){
+                fprintf(stderr, "error allocate event log\n");
+                return NULL;
+        }
+        log->buffer = malloc(EVENT_LOG_BUFFER_SIZE);
+        if(log->buffer==NULL){
+                fprintf(stderr, "error allocate event log\n");
+                free(log);
+                return NULL;
+        }
+        log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(log->fd<0){
+                fprintf(stderr, "error open %s %s\n", path, strerror(errno));
+                free(log->buffer);
+                free(log);
+                return NULL;
+        }
+        event_log_header_t *header = (event_log_header_t *)log->buffer;
+        memset(header, 0, sizeof(event_log_header_t));
+        memcpy(header->magic, EVENT_LOG_MAGIC, sizeof(header->magic));
+        header->version = EVENT_LOG_VERSION;
+        header->record_size = sizeof(event_record_t);
+        header->samplerate = samplerate;
+        header->probe_mask = probe_mask;
+        header->protocol = protocol;
+        memcpy(header->protocols, protocols, sizeof(header->protocols));
+        log->size = sizeof(event_log_header_t);
+        return log;
+}
+
+
+//append event record(s) to log buffer
+void event_log_write(event_log_t *log, event_buffer_t *buf, dump_event_t *event){
+        event_record_t *record = event_log_record(log);
+        record->type = event->type;
+        record->probe = event->probe;
+        record->time = event->time;
+        if(event->type==EVENT_PULSE){
+                record->pulse.width = event->pulse.width;
+                record->pulse.period = event->pulse.period;
+                record->pulse.width_median = event->pulse.width_median;
+                record->pulse.period_median = event->pulse.period_median;
+                record->pulse.width_average = event->pulse.width_average;
+                record->pulse.period_average = event->pulse.period_average;
+                record->pulse.width_rmsd = event->pulse.width_rmsd;
+                record->pulse.period_rmsd = event->pulse.period_rmsd;
+        } else if(event->type==EVENT_DSHOT_FRAME){
+                record->dshot_bits = event->dshot.bits;
+        } else if(event->type==EVENT_SBUS_PACKET){
+                uint8_t *packet = buf->data+event->sbus.offset;
+                int length = event->sbus.length;
+                record->length = length;
+                for(int pos=0;;){
+                        int n = length-pos<EVENT_LOG_DATA_SIZE ? length-pos : EVENT_LOG_DATA_SIZE;
+                        memcpy(record->data, packet+pos, n);
+                        pos += n;
+                        if(pos>=length){
+                                break;
+                        }
+                        record = event_log_record(log);
+                        record->type = EVENT_SBUS_DATA;
+                        record->probe = event->probe;
+                        record->length = length-pos;
+                        record->time = event->time;
+                }
+        }
+}
+
+
+//flush and close log, returns 0 if all records are written
+int event_log_close(event_log_t *log){
+        event_log_flush(log);
+        if(close(log->fd)!=0 && !log->error){
+                log->error = errno;
+        }
+        int error = log->error;
+        if(error){
+                fprintf(stderr, "error write event log %s\n", strerror(error));
+        }
+        free(log->buffer);
+        free(log);
+        return error!=0;
+}
+
+
+//read binary log header, returns 0 on success
+int event_log_read_header(FILE *f, event_log_header_t *header){
+        if(fread(header, sizeof(event_log_header_t), 1, f)!=1){
+                fprintf(stderr, "error read event log header\n");
+                return 1;
+        }
+        if(memcmp(header->magic, EVENT_LOG_MAGIC, sizeof(header->magic))!=0){
+                fprintf(stderr, "not an event log file\n");
+                return 1;
+        }
+        if(header->version!=EVENT_LOG_VERSION || header->record_size!=sizeof(event_record_t)){
+                fprintf(stderr, "unsupported event log version %u record size %u\n", header->version, header->record_size);
+                return 1;
+        }
+        return 0;
+}
+
+
+//read next event, packet bytes are stored in buf, returns 1 on event, 0 on end, -1 on error
+int event_log_read(FILE *f, event_buffer_t *buf, dump_event_t *event){
+        event_record_t record;
+        if(fread(&record, sizeof(record), 1, f)!=1){
+                return ferror(f) ? -1 : 0;
+        }
+        memset(event, 0, sizeof(dump_event_t));
+        event->type = record.type;
+        event->probe = record.probe;
+        event->time = record.time;
+        if(record.type==EVENT_PULSE){
+                event->pulse.width = record.pulse.width;
+                event->pulse.period = record.pulse.period;
+                event->pulse.width_median = record.pulse.width_median;
+                event->pulse.period_median = record.pulse.period_median;
+                event->pulse.width_average = record.pulse.width_average;
+                event->pulse.period_average = record.pulse.period_average;
+                event->pulse.width_rmsd = record.pulse.width_rmsd;
+                event->pulse.period_rmsd = record.pulse.period_rmsd;
+                return 1;
+        }
+        if(record.type==EVENT_DSHOT_FRAME){
+                event->dshot.bits = record.dshot_bits;
+                return 1;
+        }
+        if(record.type!=EVENT_SBUS_PACKET){
+                fprintf(stderr, "unexpected event log record type %d\n", record.type);
+                return -1;
+        }
+        uint8_t packet[UINT16_MAX];
+        int length = record.length;
+        for(int pos=0;;){
+                int n = length-pos<EVENT_LOG_DATA_SIZE ? length-pos : EVENT_LOG_DATA_SIZE;
+                memcpy(packet+pos, record.data, n);
+                pos += n;
+                if(pos>=length){
+                        break;
+                }
+                if(fread(&record, sizeof(record), 1, f)!=1 || record.type!=EVENT_SBUS_DATA){
+                        fprintf(stderr, "truncated sbus packet in event log\n");
+                        return -1;
+                }
+        }
+        event_buffer_clear(buf);
+        event_buffer_add_packet(buf, event->probe, event->time, packet, length);
+        if(buf->count!=1){
+                return -1;
+        }
+        *event = buf->events[0];
+        return 1;
+}
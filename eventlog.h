@@ -0,0 +1,162 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//decoded events: in-memory buffers, text dump form and binary event log
+
+//dump file event types
+#define EVENT_PULSE 1
+#define EVENT_SBUS_PACKET 2
+//continuation of sbus packet bytes, binary log only
+#define EVENT_SBUS_DATA 3
+#define EVENT_DSHOT_FRAME 4
+//anomaly of enabled trigger kind, passed to history only, not written
+#define EVENT_TRIGGER 5
+
+//decoder protocols, recorded in binary log header
+#define PROTOCOL_PWM 0
+#define PROTOCOL_SBUS 1
+#define PROTOCOL_DSHOT 2
+#define PROTOCOLS 3
+//probe is not decoded
+#define PROTOCOL_OFF 0xFF
+//decoded probes use different protocols
+#define PROTOCOL_MIXED -1
+
+//decoded event, written to dump file in (time, probe) order
+typedef struct dump_event {
+        uint8_t type;
+        uint8_t probe;
+        int64_t time;
+        union {
+                struct {
+                        int width;
+                        int period;
+                        int width_median;
+                        int period_median;
+                        double width_average;
+                        double period_average;
+                        double width_rmsd;
+                        double period_rmsd;
+                } pulse;
+                struct {
+                        int offset;//in event_buffer_t data
+                        int length;
+                } sbus;
+                struct {
+                        uint16_t bits;//received frame, crc not checked
+                } dshot;
+                struct {
+                        int reason;//TRIGGER_*
+                } trigger;
+        };
+} dump_event_t;
+
+//growing buffer of dump events
+typedef struct event_buffer {
+        dump_event_t *events;
+        int count;
+        int capacity;
+
+        uint8_t *data;//sbus packet bytes
+        int data_size;
+        int data_capacity;
+
+        int dropped;//events lost on allocation failure
+} event_buffer_t;
+
+
+//binary event log file: header, then fixed size little-endian records in (time, probe) order
+//sbus packet record carries first EVENT_LOG_DATA_SIZE bytes, the rest follows in EVENT_SBUS_DATA records
+#define EVENT_LOG_MAGIC "PWMEVLOG"
+#define EVENT_LOG_VERSION 1
+#define EVENT_LOG_DATA_SIZE 48
+#define EVENT_LOG_BUFFER_SIZE (1024*1024)
+
+typedef struct event_log_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t samplerate;//Hz
+        uint32_t probe_mask;
+        uint32_t protocol;//PROTOCOL_* of all decoded probes, UINT32_MAX (PROTOCOL_MIXED) if they differ
+        uint8_t protocols[32];//PROTOCOL_* of every probe, PROTOCOL_OFF if not decoded
+} event_log_header_t;
+
+typedef struct event_record {
+        uint8_t type;
+        uint8_t probe;
+        uint16_t length;//sbus packet length
+        uint32_t reserved;
+        int64_t time;
+        union {
+                struct {
+                        int32_t width;
+                        int32_t period;
+                        int32_t width_median;
+                        int32_t period_median;
+                        double width_average;
+                        double period_average;
+                        double width_rmsd;
+                        double period_rmsd;
+                } pulse;
+                uint8_t data[EVENT_LOG_DATA_SIZE];
+                uint16_t dshot_bits;
+        };
+} event_record_t;
+
+_Static_assert(sizeof(event_log_header_t)==64, "event log header size");
+_Static_assert(sizeof(event_record_t)==64, "event log record size");
+
+//buffered binary log writer
+typedef struct event_log {
+        int fd;
+        uint8_t *buffer;
+        size_t size;
+        int error;//errno of failed write
+} event_log_t;
+
+
+//grow events array, returns false if buffer can not grow
+bool event_buffer_grow(event_buffer_t *buf);
+
+//append event to buffer, returns NULL if buffer can not grow
+static inline dump_event_t *event_buffer_add(event_buffer_t *buf, int type, int probe_idx, int64_t time){
+        if(buf->count>=buf->capacity && !event_buffer_grow(buf)){
+                return NULL;
+        }
+        dump_event_t *event = &buf->events[buf->count++];
+        event->type = type;
+        event->probe = probe_idx;
+        event->time = time;
+        return event;
+}
+
+void event_buffer_add_packet(event_buffer_t *buf, int probe_idx, int64_t time, uint8_t *packet, int length);
+void event_buffer_clear(event_buffer_t *buf);
+void event_buffer_free(event_buffer_t *buf);
+
+//print sbus packet bits and channel values
+void decode_sbus_packet(FILE *f, uint8_t *packet, size_t len);
+
+//write one dump event in text form
+void write_dump_event(FILE *f, event_buffer_t *buf, dump_event_t *event);
+
+//write events of several buffers, merged in (time, probe) order, to text dump and/or binary log
+void write_dump_events(FILE *f, event_log_t *log, event_buffer_t **buffers, int buffers_n);
+
+//create binary log file and write header, returns NULL on error
+event_log_t *event_log_open(const char *path, uint64_t samplerate, uint32_t probe_mask, int protocol, const uint8_t *protocols);
+void event_log_write(event_log_t *log, event_buffer_t *buf, dump_event_t *event);
+//flush and close log, returns 0 if all records are written
+int event_log_close(event_log_t *log);
+
+//read binary log header, returns 0 on success
+int event_log_read_header(FILE *f, event_log_header_t *header);
+//read next event, packet bytes are stored in buf, returns 1 on event, 0 on end, -1 on error
+int event_log_read(FILE *f, event_buffer_t *buf, dump_event_t *event);
+
+#endif
@@ -0,0 +1,532 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <getopt.h>
+
+//synthetic signal generator, writes sigrok binary stream (as sigrok-cli -O binary) to stdout
+//for benchmarks and tests of pwm decoder
+
+#define MAX_PROBES 32
+#define MAX_SIGNALS MAX_PROBES
+#define BLOCK_SAMPLES 65536
+#define QUEUE_SIZE (25*12+4)
+
+#define SBUS_CHANNELS 16
+#define SBUS_FRAME_SIZE 25
+
+#define SIGNAL_PWM 1
+#define SIGNAL_SBUS 2
+#define SIGNAL_DSHOT 3
+#define SIGNAL_NOISE 4
+
+//one generated probe signal
+typedef struct signal {
+        int type;
+        int probe;
+
+        //pwm, in samples
+        double period;
+        double width;
+        double jitter;
+        double phase;
+
+        //sbus
+        double frame_period;//samples
+        double bit;//samples
+        int values[SBUS_CHANNELS];
+        int ramp;//channel 0 ramps over frames
+        int failsafe_every;
+        int lost_every;
+        int parity_every;
+
+        //dshot, frame_period and bit as sbus
+        int throttle;
+        int telemetry_every;
+        int crc_every;
+
+        //noise, in samples
+        double run;//mean time between transitions
+        double position;//time of last transition
+
+        //transitions of current pulse or frame
+        int64_t queue_time[QUEUE_SIZE];
+        uint8_t queue_level[QUEUE_SIZE];
+        int queue_n;
+        int queue_pos;
+        long index;//pulse/frame number
+        int level;
+} signal_t;
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+
+//xorshift random in [-1, 1]
+static double random_unit(){
+        random_state ^= random_state<<13;
+        random_state ^= random_state>>7;
+        random_state ^= random_state<<17;
+        return (random_state>>11)*(2.0/9007199254740992.0)-1.0;
+}
+
+
+static void queue_add(signal_t *sig, double time, int level){
+        int64_t t = llround(time);
+        if(sig->queue_n>0){
+                int last = sig->queue_n-1;
+                if(sig->queue_level[last]==level){
+                        return;
+                }
+                if(t<=sig->queue_time[last]){
+                        t = sig->queue_time[last]+1;
+                }
+        }
+        sig->queue_time[sig->queue_n] = t;
+        sig->queue_level[sig->queue_n] = level;
+        sig->queue_n++;
+}
+
+
+//rising and falling edge of next pwm pulse
+static void next_pulse(signal_t *sig){
+        double start = sig->phase + sig->index*sig->period + sig->jitter*random_unit();
+        double width = sig->width + sig->jitter*random_unit();
+        if(start<0){
+                start = 0;
+        }
+        if(width<1){
+                width = 1;
+        }
+        queue_add(sig, start, 1);
+        queue_add(sig, start+width, 0);
+}
+
+
+//next transition of random noise, run length uniform in (0, 2*run)
+static void next_noise(signal_t *sig){
+        sig->position += sig->run*(1+random_unit());
+        queue_add(sig, sig->position, !(sig->index & 1));
+}
+
+
+//sbus frame bytes: header, 16 channels of 11 bits, flags, footer
+static void build_sbus_frame(signal_t *sig, uint8_t *frame){
+        memset(frame, 0, SBUS_FRAME_SIZE);
+        frame[0] = 0x0F;
+        int bit = 0;
+        for(int ch=0;ch<SBUS_CHANNELS;ch++){
+                int value = sig->values[ch];
+                if(ch==0 && sig->ramp){
+                        value = 172 + (sig->index*sig->ramp) % (1811-172);
+                }
+                for(int i=0;i<11;i++,bit++){
+                        if(value & (1<<i)){
+                                frame[1+bit/8] |= 1<<(bit%8);
+                        }
+                }
+        }
+        uint8_t flags = 0;
+        if(sig->lost_every && (sig->index % sig->lost_every)==sig->lost_every-1){
+                flags |= 0x04;
+        }
+        if(sig->failsafe_every && (sig->index % sig->failsafe_every)==sig->failsafe_every-1){
+                flags |= 0x0C;
+        }
+        frame[23] = flags;
+        frame[24] = 0x00;
+}
+
+
+//transitions of next sbus frame, inverted 8E2 uart
+static void next_sbus_frame(signal_t *sig){
+        uint8_t frame[SBUS_FRAME_SIZE];
+        build_sbus_frame(sig, frame);
+        int bad_byte = -1;
+        if(sig->parity_every && (sig->index % sig->parity_every)==sig->parity_every-1){
+                bad_byte = 1+sig->index % (SBUS_FRAME_SIZE-1);
+        }
+        double start = sig->index*sig->frame_period;
+        for(int b=0;b<SBUS_FRAME_SIZE;b++){
+                double byte_start = start + b*12*sig->bit;
+                int parity = __builtin_popcount(frame[b]) & 1;
+                if(b==bad_byte){
+                        parity ^= 1;
+                }
+                //uart levels: start 0, data lsb first, even parity, 2 stop 1; line is inverted
+                for(int i=0;i<12;i++){
+                        int uart;
+                        if(i==0){
+                                uart = 0;
+                        } else if(i<9){
+                                uart = (frame[b]>>(i-1)) & 1;
+                        } else if(i==9){
+                                uart = parity;
+                        } else {
+                                uart = 1;
+                        }
+                        queue_add(sig, byte_start + i*sig->bit, !uart);
+                }
+        }
+        queue_add(sig, start + SBUS_FRAME_SIZE*12*sig->bit, 0);
+}
+
+
+//transitions of next dshot frame: 16 bits msb first, '1' high 3/4 of bit, '0' high 3/8
+static void next_dshot_frame(signal_t *sig){
+        int throttle = sig->throttle;
+        if(sig->ramp){
+                throttle = 48 + (sig->index*sig->ramp) % (2048-48);
+        }
+        int telemetry = sig->telemetry_every && (sig->index % sig->telemetry_every)==sig->telemetry_every-1;
+        int value = (throttle<<1) | telemetry;
+        int crc = (value ^ (value>>4) ^ (value>>8)) & 0x0F;
+        if(sig->crc_every && (sig->index % sig->crc_every)==sig->crc_every-1){
+                crc ^= 1;
+        }
+        int frame = (value<<4) | crc;
+        double start = sig->index*sig->frame_period;
+        for(int i=0;i<16;i++){
+                double bit_start = start + i*sig->bit;
+                queue_add(sig, bit_start, 1);
+                queue_add(sig, bit_start + sig->bit*((frame>>(15-i)) & 1 ? 0.75 : 0.375), 0);
+        }
+}
+
+
+//time of next transition of signal, refills queue
+static int64_t next_transition(signal_t *sig){
+        if(sig->queue_pos>=sig->queue_n){
+                int64_t last = sig->queue_n>0 ? sig->queue_time[sig->queue_n-1] : -1;
+                sig->queue_n = 0;
+                sig->queue_pos = 0;
+                if(sig->type==SIGNAL_PWM){
+                        next_pulse(sig);
+                } else if(sig->type==SIGNAL_DSHOT){
+                        next_dshot_frame(sig);
+                } else if(sig->type==SIGNAL_NOISE){
+                        next_noise(sig);
+                } else {
+                        next_sbus_frame(sig);
+                }
+                sig->index++;
+                //keep transitions ordered if jitter overlaps pulses
+                for(int i=0;i<sig->queue_n;i++){
+                        if(sig->queue_time[i]<=last){
+                                sig->queue_time[i] = last+1;
+                        }
+                        last = sig->queue_time[i];
+                }
+        }
+        return sig->queue_time[sig->queue_pos];
+}
+
+
+//parse probe list like "0,1,4-7" into bit mask, returns 0 on success
+static int parse_probes(const char *list, uint32_t *mask){
+        *mask = 0;
+        const char *p = list;
+        while(*p){
+                char *end;
+                long first = strtol(p, &end, 10);
+                long last = first;
+                if(end==p){
+                        return 1;
+                }
+                p = end;
+                if(*p=='-'){
+                        p++;
+                        last = strtol(p, &end, 10);
+                        if(end==p){
+                                return 1;
+                        }
+                        p = end;
+                }
+                if(first<0 || last>=MAX_PROBES || first>last){
+                        return 1;
+                }
+                for(long i=first;i<=last;i++){
+                        *mask |= 1U<<i;
+                }
+                if(*p==','){
+                        p++;
+                } else if(*p){
+                        return 1;
+                }
+        }
+        return *mask==0;
+}
+
+
+//parse signal spec "probes:type[,key=value...]", adds signals for all listed probes
+static int parse_signal(const char *spec, double samplerate_hz, signal_t *signals, int *signals_n){
+        char buf[1024];
+        snprintf(buf, sizeof(buf), "%s", spec);
+        char *colon = strchr(buf, ':');
+        if(colon==NULL){
+                return 1;
+        }
+        *colon = 0;
+        uint32_t mask;
+        if(parse_probes(buf, &mask)){
+                return 1;
+        }
+        char *type = colon+1;
+        char *params = strchr(type, ',');
+        if(params!=NULL){
+                *params++ = 0;
+        }
+
+        signal_t proto;
+        memset(&proto, 0, sizeof(proto));
+        double us = samplerate_hz/1e6;
+        double phase_step = 0;
+        if(strcmp(type, "pwm")==0){
+                proto.type = SIGNAL_PWM;
+                proto.period = 20000*us;
+                proto.width = 1500*us;
+        } else if(strcmp(type, "sbus")==0){
+                proto.type = SIGNAL_SBUS;
+                proto.frame_period = 14000*us;
+                proto.bit = samplerate_hz/100000;
+                for(int i=0;i<SBUS_CHANNELS;i++){
+                        proto.values[i] = 992;
+                }
+        } else if(strcmp(type, "dshot")==0){
+                proto.type = SIGNAL_DSHOT;
+                proto.frame_period = 1000*us;
+                proto.bit = samplerate_hz/600000;
+                proto.throttle = 1000;
+        } else if(strcmp(type, "noise")==0){
+                proto.type = SIGNAL_NOISE;
+                proto.run = 10*us;
+        } else {
+                return 1;
+        }
+
+        for(char *kv=params ? strtok(params, ",") : NULL; kv!=NULL; kv=strtok(NULL, ",")){
+                char *eq = strchr(kv, '=');
+                if(eq==NULL){
+                        return 1;
+                }
+                *eq = 0;
+                char *value = eq+1;
+                if(strcmp(kv, "period")==0){
+                        //us for pwm and dshot, ms for sbus
+                        if(proto.type==SIGNAL_PWM){
+                                proto.period = atof(value)*us;
+                        } else if(proto.type==SIGNAL_DSHOT){
+                                proto.frame_period = atof(value)*us;
+                        } else {
+                                proto.frame_period = atof(value)*1000*us;
+                        }
+                } else if(strcmp(kv, "run")==0){
+                        proto.run = atof(value)*us;
+                } else if(strcmp(kv, "width")==0){
+                        proto.width = atof(value)*us;
+                } else if(strcmp(kv, "jitter")==0){
+                        proto.jitter = atof(value)*us;
+                } else if(strcmp(kv, "phase")==0){
+                        phase_step = atof(value)*us;
+                } else if(strcmp(kv, "values")==0){
+                        //channel values separated by ';'
+                        int ch = 0;
+                        for(char *v=value; *v && ch<SBUS_CHANNELS; ch++){
+                                proto.values[ch] = strtol(v, &v, 10) & 0x7FF;
+                                if(*v==';'){
+                                        v++;
+                                }
+                        }
+                } else if(strcmp(kv, "ramp")==0){
+                        proto.ramp = atoi(value);
+                } else if(strcmp(kv, "failsafe")==0){
+                        proto.failsafe_every = atoi(value);
+                } else if(strcmp(kv, "lost")==0){
+                        proto.lost_every = atoi(value);
+                } else if(strcmp(kv, "parity")==0){
+                        proto.parity_every = atoi(value);
+                } else if(strcmp(kv, "rate")==0){
+                        //dshot bit rate in kbit/s
+                        proto.bit = samplerate_hz/(atof(value)*1000);
+                } else if(strcmp(kv, "throttle")==0){
+                        proto.throttle = atoi(value) & 0x7FF;
+                } else if(strcmp(kv, "telemetry")==0){
+                        proto.telemetry_every = atoi(value);
+                } else if(strcmp(kv, "crc")==0){
+                        proto.crc_every = atoi(value);
+                } else {
+                        return 1;
+                }
+        }
+        if(proto.type==SIGNAL_PWM && (proto.period<2 || proto.width>=proto.period)){
+                fprintf(stderr, "invalid pwm period/width in %s\n", spec);
+                return 1;
+        }
+        if(proto.type==SIGNAL_NOISE && proto.run<1){
+                fprintf(stderr, "noise run shorter than sample in %s\n", spec);
+                return 1;
+        }
+        if(proto.type==SIGNAL_SBUS && proto.frame_period<SBUS_FRAME_SIZE*12*proto.bit){
+                fprintf(stderr, "sbus frame period too short in %s\n", spec);
+                return 1;
+        }
+
+        if(proto.type==SIGNAL_DSHOT && (proto.bit<2 || proto.frame_period<17*proto.bit)){
+                fprintf(stderr, "invalid dshot rate or frame period in %s\n", spec);
+                return 1;
+        }
+
+        int n = 0;
+        while(mask){
+                int probe = __builtin_ctz(mask);
+                if(*signals_n>=MAX_SIGNALS){
+                        return 1;
+                }
+                signal_t *sig = &signals[(*signals_n)++];
+                *sig = proto;
+                sig->probe = probe;
+                sig->phase = n*phase_step;
+                n++;
+                mask &= mask-1;
+        }
+        return 0;
+}
+
+
+static void show_help(){
+        printf("pwmgen: synthetic sigrok binary stream generator\n");
+        printf(" Usage: pwmgen -s samplerate_khz (-t seconds | -N samples) [-u unitsize] [-r seed] -g signal [-g signal...] > file\n");
+        printf("  signal is probes:type[,key=value...], probes as 0,1,4-7\n");
+        printf("   pwm:  period=us (20000) width=us (1500) jitter=us (0) phase=us (0, added per probe)\n");
+        printf("   sbus: period=ms (14) values=v1;v2;... (992) ramp=step (0) failsafe=n lost=n parity=n\n");
+        printf("         failsafe/lost flag or parity error is set in every n-th frame\n");
+        printf("   dshot: rate=kbit/s (600) period=us (1000) throttle=v (1000) ramp=step (0) telemetry=n crc=n\n");
+        printf("         telemetry request or crc error is set in every n-th frame\n");
+        printf("   noise: run=us (10) random level changes, run length uniform up to 2*run\n");
+        printf(" Example: pwmgen -s 24000 -t 2 -g 0-5:pwm,period=2500,jitter=1 -g 6:sbus,parity=100 > test.bin\n");
+}
+
+
+int main(int argc, char **argv){
+        signal_t *signals = calloc(MAX_SIGNALS, sizeof(signal_t));
+        int signals_n = 0;
+        double samplerate_hz = 0;
+        double seconds = 0;
+        int64_t total = 0;
+        int unitsize = 0;
+        int ch;
+        char *specs[MAX_SIGNALS];
+        int specs_n = 0;
+
+        if(signals==NULL){
+                fprintf(stderr, "error allocate signals\n");
+                return 1;
+        }
+
+        while((ch = getopt(argc, argv, "hs:t:N:u:r:g:")) != -1){
+                switch(ch){
+                case 'h':
+                        show_help();
+                        return 0;
+                case 's':
+                        samplerate_hz = atof(optarg)*1000;
+                        break;
+                case 't':
+                        seconds = atof(optarg);
+                        break;
+                case 'N':
+                        total = atoll(optarg);
+                        break;
+                case 'u':
+                        unitsize = atoi(optarg);
+                        break;
+                case 'r':
+                        random_state = strtoull(optarg, NULL, 0) | 1;
+                        break;
+                case 'g':
+                        if(specs_n<MAX_SIGNALS){
+                                specs[specs_n++] = optarg;
+                        }
+                        break;
+                default:
+                        show_help();
+                        return 1;
+                }
+        }
+        if(samplerate_hz<=0 || specs_n==0 || (seconds<=0 && total<=0)){
+                show_help();
+                return 1;
+        }
+        if(total<=0){
+                total = llround(seconds*samplerate_hz);
+        }
+        for(int i=0;i<specs_n;i++){
+                if(parse_signal(specs[i], samplerate_hz, signals, &signals_n)){
+                        fprintf(stderr, "invalid signal %s\n", specs[i]);
+                        return 1;
+                }
+        }
+
+        int highest = 0;
+        for(int i=0;i<signals_n;i++){
+                if(signals[i].probe>highest){
+                        highest = signals[i].probe;
+                }
+        }
+        if(unitsize==0){
+                unitsize = highest<8 ? 1 : highest<16 ? 2 : 4;
+        }
+        if((unitsize!=1 && unitsize!=2 && unitsize!=4) || highest>=unitsize*8){
+                fprintf(stderr, "invalid unitsize %d\n", unitsize);
+                return 1;
+        }
+
+        uint32_t *samples = malloc(BLOCK_SAMPLES*sizeof(uint32_t));
+        uint8_t *out = malloc(BLOCK_SAMPLES*unitsize);
+        if(samples==NULL || out==NULL){
+                fprintf(stderr, "error allocate buffers\n");
+                return 1;
+        }
+
+        for(int64_t t0=0;t0<total;t0+=BLOCK_SAMPLES){
+                int64_t t1 = t0+BLOCK_SAMPLES<total ? t0+BLOCK_SAMPLES : total;
+                memset(samples, 0, (t1-t0)*sizeof(uint32_t));
+                for(int i=0;i<signals_n;i++){
+                        signal_t *sig = &signals[i];
+                        uint32_t bit = 1U<<sig->probe;
+                        int64_t t = t0;
+                        while(t<t1){
+                                int64_t next = next_transition(sig);
+                                int64_t end = next<t1 ? next : t1;
+                                if(sig->level){
+                                        for(int64_t j=t;j<end;j++){
+                                                samples[j-t0] |= bit;
+                                        }
+                                }
+                                if(end>t){
+                                        t = end;
+                                }
+                                if(t==next){
+                                        sig->level = sig->queue_level[sig->queue_pos++];
+                                }
+                        }
+                }
+                int n = t1-t0;
+                for(int j=0;j<n;j++){
+                        for(int b=0;b<unitsize;b++){
+                                out[j*unitsize+b] = samples[j]>>(8*b);
+                        }
+                }
+                if(fwrite(out, unitsize, n, stdout)!=(size_t)n){
+                        fprintf(stderr, "error write output\n");
+                        return 1;
+                }
+        }
+
+        free(samples);
+        free(out);
+        free(signals);
+        return 0;
+}
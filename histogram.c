@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram.h"
+
+
+//allocate buckets, returns 0 on success
+int init_histogram(histogram_t *h){
+        memset(h, 0, sizeof(histogram_t));
+        h->counts = calloc(HISTOGRAM_BUCKETS, sizeof(uint64_t));
+        return h->counts==NULL;
+}
+
+
+void free_histogram(histogram_t *h){
+        free(h->counts);
+        h->counts = NULL;
+}
+
+
+void histogram_clear(histogram_t *h){
+        memset(h->counts, 0, HISTOGRAM_BUCKETS*sizeof(uint64_t));
+        h->total = 0;
+        h->min_value = 0;
+        h->max_value = 0;
+}
+
+
+//lowest value and width of bucket
+void histogram_bucket(int index, int64_t *low, int64_t *width){
+        if(index<(1<<HISTOGRAM_SUB_BITS)){
+                *low = index;
+                *width = 1;
+                return;
+        }
+        int shift = (index>>(HISTOGRAM_SUB_BITS-1))-1;
+        int64_t sub = index-((int64_t)shift<<(HISTOGRAM_SUB_BITS-1));
+        *low = sub<<shift;
+        *width = (int64_t)1<<shift;
+}
+
+
+//value at percentile (0..100), middle of bucket, -1 if histogram is empty
+double histogram_percentile(const histogram_t *h, double percentile){
+        if(h->total==0){
+                return -1;
+        }
+        uint64_t rank = (uint64_t)(percentile/100.0*h->total+0.5);
+        if(rank<1){
+                rank = 1;
+        }
+        if(rank>h->total){
+                rank = h->total;
+        }
+        uint64_t count = 0;
+        int index = histogram_index(h->max_value);
+        for(int i=0;i<HISTOGRAM_BUCKETS;i++){
+                count += h->counts[i];
+                if(count>=rank){
+                        index = i;
+                        break;
+                }
+        }
+        int64_t low, width;
+        histogram_bucket(index, &low, &width);
+        double value = low+(width-1)/2.0;
+        //exact bounds are known
+        if(value<h->min_value){
+                value = h->min_value;
+        }
+        if(value>h->max_value){
+                value = h->max_value;
+        }
+        return value;
+}
+
+
+//write non-empty buckets as csv lines: probe,name,low,high,count
+void histogram_export(FILE *f, const histogram_t *h, int probe_idx, const char *name){
+        for(int i=0;i<HISTOGRAM_BUCKETS;i++){
+                if(h->counts[i]==0){
+                        continue;
+                }
+                int64_t low, width;
+                histogram_bucket(i, &low, &width);
+                fprintf(f, "%d,%s,%lld,%lld,%llu\n", probe_idx, name, (long long)low, (long long)(low+width-1), (unsigned long long)h->counts[i]);
+        }
+}
@@ -0,0 +1,59 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+//log-linear histogram of non-negative int values (samples)
+//values below 2^HISTOGRAM_SUB_BITS get own bucket, every further power of two range is split
+//into 2^(HISTOGRAM_SUB_BITS-1) buckets, so bucket width is at most 1/512 of value
+//memory is fixed, HISTOGRAM_BUCKETS 64-bit counters (92 KiB), update is O(1)
+#define HISTOGRAM_SUB_BITS 10
+#define HISTOGRAM_BUCKETS ((32-HISTOGRAM_SUB_BITS+1)<<(HISTOGRAM_SUB_BITS-1))
+
+typedef struct histogram {
+        uint64_t total;
+        int min_value;
+        int max_value;
+        uint64_t *counts;
+} histogram_t;
+
+
+//allocate buckets, returns 0 on success
+int init_histogram(histogram_t *h);
+void free_histogram(histogram_t *h);
+void histogram_clear(histogram_t *h);
+
+static inline int histogram_index(uint32_t value){
+        if(value<(1U<<HISTOGRAM_SUB_BITS)){
+                return value;
+        }
+        int shift = 31-__builtin_clz(value)-HISTOGRAM_SUB_BITS+1;
+        return (shift<<(HISTOGRAM_SUB_BITS-1)) + (value>>shift);
+}
+
+//add value, negative values are counted as 0
+static inline void histogram_add(histogram_t *h, int value){
+        if(value<0){
+                value = 0;
+        }
+        h->counts[histogram_index(value)]++;
+        if(h->total==0 || value<h->min_value){
+                h->min_value = value;
+        }
+        if(h->total==0 || value>h->max_value){
+                h->max_value = value;
+        }
+        h->total++;
+}
+
+//lowest value and width of bucket
+void histogram_bucket(int index, int64_t *low, int64_t *width);
+
+//value at percentile (0..100), middle of bucket, -1 if histogram is empty
+double histogram_percentile(const histogram_t *h, double percentile);
+
+//write non-empty buckets as csv lines: probe,name,low,high,count
+void histogram_export(FILE *f, const histogram_t *h, int probe_idx, const char *name);
+
+#endif
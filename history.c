@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "pwm.h"
+#include "history.h"
+
+#define DUMP_BUFFER_SIZE 65536
+
+static const struct {
+        const char *name;
+        int trigger;
+} trigger_names[] = {
+        { "parity", TRIGGER_PARITY },
+        { "frame", TRIGGER_FRAME },
+        { "failsafe", TRIGGER_FAILSAFE },
+        { "lost", TRIGGER_LOST },
+        { "dshot", TRIGGER_DSHOT },
+        { "width", TRIGGER_WIDTH },
+};
+
+
+const char *trigger_name(int trigger){
+        for(size_t i=0;i<sizeof(trigger_names)/sizeof(trigger_names[0]);i++){
+                if(trigger_names[i].trigger==trigger){
+                        return trigger_names[i].name;
+                }
+        }
+        return "unknown";
+}
+
+
+//parse trigger list, e.g. parity,failsafe,width=900-2100 (us), returns 0 on success
+int parse_trigger_list(const char *list, uint32_t *triggers, int *width_min_us, int *width_max_us){
+        *triggers = 0;
+        const char *p = list;
+        while(*p){
+                const char *end = strchr(p, ',');
+                size_t len = end ? (size_t)(end-p) : strlen(p);
+                if(len>6 && strncmp(p, "width=", 6)==0){
+                        char *e;
+                        long lo = strtol(p+6, &e, 10);
+                        if(*e!='-'){
+                                return 1;
+                        }
+                        long hi = strtol(e+1, &e, 10);
+                        if(e!=p+len || lo<0 || hi<lo){
+                                return 1;
+                        }
+                        *width_min_us = lo;
+                        *width_max_us = hi;
+                        *triggers |= TRIGGER_WIDTH;
+                } else if(len==3 && strncmp(p, "all", 3)==0){
+                        //all decoder errors, pwm range has no default
+                        *triggers |= TRIGGER_PARITY | TRIGGER_FRAME | TRIGGER_FAILSAFE | TRIGGER_LOST | TRIGGER_DSHOT;
+                } else {
+                        int trigger = 0;
+                        for(size_t i=0;i<sizeof(trigger_names)/sizeof(trigger_names[0]);i++){
+                                if(trigger_names[i].trigger!=TRIGGER_WIDTH && strlen(trigger_names[i].name)==len &&
+                                   strncmp(p, trigger_names[i].name, len)==0){
+                                        trigger = trigger_names[i].trigger;
+                                }
+                        }
+                        if(trigger==0){
+                                return 1;
+                        }
+                        *triggers |= trigger;
+                }
+                p += len;
+                if(*p==','){
+                        p++;
+                }
+        }
+        return *triggers==0;
+}
+
+
+//allocate history of probes, pre and post in samples, returns NULL on error
+history_t *history_open(uint32_t probe_mask, int unitsize, int samplerate, int64_t pre, int64_t post, const char *prefix, int64_t start_time){
+        history_t *h = calloc(1, sizeof(history_t));
+        if(h==NULL){
+                fprintf(stderr, "error allocate history\n");
+                return NULL;
+        }
+        h->probe_mask = probe_mask;
+        h->unitsize = unitsize;
+        h->samplerate = samplerate;
+        h->start_time = start_time;
+        h->end_time = start_time;
+        h->pre = pre;
+        h->post = post;
+        h->prefix = prefix;
+        h->dumped_until = start_time;
+        init_edge_detector(&h->detector, probe_mask);
+        h->edges = malloc(EDGE_BUFFER_SIZE*sizeof(edge_t));
+        uint32_t capacity = HISTORY_MEMORY/sizeof(int64_t)/__builtin_popcount(probe_mask);
+        bool error = h->edges==NULL;
+        for(int i=0;i<32 && !error;i++){
+                if(probe_mask & (1U<<i)){
+                        h->probes[i].capacity = capacity;
+                        h->probes[i].times = malloc(capacity*sizeof(int64_t));
+                        error = h->probes[i].times==NULL;
+                }
+        }
+        if(error){
+                fprintf(stderr, "error allocate history\n");
+                for(int i=0;i<32;i++){
+                        free(h->probes[i].times);
+                }
+                free(h->edges);
+                free(h);
+                return NULL;
+        }
+        return h;
+}
+
+
+//record edges already extracted by decoder, in time order per probe
+void history_add(history_t *h, const edge_t *edges, int n){
+        for(int i=0;i<n;i++){
+                history_probe_t *p = &h->probes[edges[i].probe];
+                if(p->times==NULL){
+                        continue;
+                }
+                p->times[p->count % p->capacity] = edges[i].time;
+                p->count++;
+                p->level = edges[i].value;
+        }
+}
+
+
+//extract and record edges of block, block[0] has time base_time
+void history_add_block(history_t *h, const uint8_t *block, size_t samples, int64_t base_time){
+        size_t pos = 0;
+        while(pos<samples){
+                int n = extract_edges(&h->detector, h->unitsize, block, samples, &pos, base_time, h->edges, EDGE_BUFFER_SIZE);
+                history_add(h, h->edges, n);
+        }
+}
+
+
+//oldest edge index still in ring
+static uint64_t oldest_edge(const history_probe_t *p){
+        return p->count>p->capacity ? p->count-p->capacity : 0;
+}
+
+
+static inline int64_t edge_time(const history_probe_t *p, uint64_t k){
+        return p->times[k % p->capacity];
+}
+
+
+//write run of same sample, buffer is flushed when full
+static void write_run(FILE *f, uint8_t *buffer, size_t *fill, uint32_t sample, int unitsize, int64_t n){
+        for(int64_t i=0;i<n;i++){
+                if(*fill+unitsize>DUMP_BUFFER_SIZE){
+                        fwrite(buffer, 1, *fill, f);
+                        *fill = 0;
+                }
+                for(int b=0;b<unitsize;b++){
+                        buffer[(*fill)++] = sample>>(8*b);
+                }
+        }
+}
+
+
+//expand recorded edges around pending trigger to sigrok binary file
+static void write_dump(history_t *h){
+        h->pending = false;
+        int64_t start = h->trigger_time-h->pre;
+        if(start<h->start_time){
+                start = h->start_time;
+        }
+        int64_t end = h->trigger_time+h->post;
+        if(end>h->end_time){
+                end = h->end_time;
+        }
+
+        //levels before oldest kept edge are unknown
+        uint32_t probes = h->probe_mask;
+        while(probes){
+                history_probe_t *p = &h->probes[__builtin_ctz(probes)];
+                if(p->count>p->capacity && edge_time(p, oldest_edge(p))>start){
+                        start = edge_time(p, oldest_edge(p));
+                }
+                probes &= probes-1;
+        }
+        if(start>end){
+                start = end;
+        }
+
+        //level at start and first edge after start of every probe
+        uint64_t cursors[32];
+        uint32_t sample = 0;
+        probes = h->probe_mask;
+        while(probes){
+                int probe_idx = __builtin_ctz(probes);
+                history_probe_t *p = &h->probes[probe_idx];
+                uint64_t lo = oldest_edge(p), hi = p->count;
+                while(lo<hi){
+                        uint64_t mid = lo+(hi-lo)/2;
+                        if(edge_time(p, mid)<=start){
+                                lo = mid+1;
+                        } else {
+                                hi = mid;
+                        }
+                }
+                cursors[probe_idx] = lo;
+                if(p->level ^ ((p->count-lo) & 1)){
+                        sample |= 1U<<probe_idx;
+                }
+                probes &= probes-1;
+        }
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s-%d.bin", h->prefix, h->dumps+1);
+        FILE *f = fopen(path, "wb");
+        uint8_t *buffer = malloc(DUMP_BUFFER_SIZE);
+        if(f==NULL || buffer==NULL){
+                fprintf(stderr, "error open %s %s\n", path, strerror(errno));
+                if(f!=NULL){
+                        fclose(f);
+                }
+                free(buffer);
+                return;
+        }
+        size_t fill = 0;
+        int64_t time = start;
+        while(time<end){
+                int64_t next = end;
+                probes = h->probe_mask;
+                while(probes){
+                        int probe_idx = __builtin_ctz(probes);
+                        history_probe_t *p = &h->probes[probe_idx];
+                        if(cursors[probe_idx]<p->count && edge_time(p, cursors[probe_idx])<next){
+                                next = edge_time(p, cursors[probe_idx]);
+                        }
+                        probes &= probes-1;
+                }
+                write_run(f, buffer, &fill, sample, h->unitsize, next-time);
+                time = next;
+                probes = h->probe_mask;
+                while(probes){
+                        int probe_idx = __builtin_ctz(probes);
+                        history_probe_t *p = &h->probes[probe_idx];
+                        if(cursors[probe_idx]<p->count && edge_time(p, cursors[probe_idx])==time){
+                                sample ^= 1U<<probe_idx;
+                                cursors[probe_idx]++;
+                        }
+                        probes &= probes-1;
+                }
+        }
+        fwrite(buffer, 1, fill, f);
+        free(buffer);
+        if(fclose(f)!=0){
+                fprintf(stderr, "error write %s %s\n", path, strerror(errno));
+                return;
+        }
+        h->dumps++;
+        h->dumped_until = end;
+        double rate = h->samplerate*1e3;
+        fprintf(stderr, "trigger %s p:%d at %.6fs, wrote %s: %.6fs from %.6fs\n", trigger_name(h->trigger_reason),
+                h->trigger_probe, h->trigger_time/rate, path, (end-start)/rate, start/rate);
+}
+
+
+//take anomalies from event buffers of block
+void history_add_events(history_t *h, event_buffer_t **buffers, int buffers_n){
+        for(int i=0;i<buffers_n;i++){
+                for(int e=0;e<buffers[i]->count;e++){
+                        dump_event_t *event = &buffers[i]->events[e];
+                        if(event->type!=EVENT_TRIGGER){
+                                continue;
+                        }
+                        h->triggers++;
+                        //later triggers are only counted
+                        if(h->dumps>=HISTORY_MAX_DUMPS){
+                                continue;
+                        }
+                        if(h->anomalies_n>=h->anomalies_capacity){
+                                int capacity = h->anomalies_capacity ? 2*h->anomalies_capacity : 256;
+                                history_anomaly_t *anomalies = realloc(h->anomalies, capacity*sizeof(history_anomaly_t));
+                                if(anomalies==NULL){
+                                        fprintf(stderr, "error allocate history anomalies\n");
+                                        continue;
+                                }
+                                h->anomalies = anomalies;
+                                h->anomalies_capacity = capacity;
+                        }
+                        h->anomalies[h->anomalies_n++] = (history_anomaly_t){ event->time, event->probe, event->trigger.reason };
+                }
+        }
+}
+
+
+static int compare_anomalies(const void *a, const void *b){
+        const history_anomaly_t *x = a, *y = b;
+        if(x->time!=y->time){
+                return x->time<y->time ? -1 : 1;
+        }
+        if(x->probe!=y->probe){
+                return x->probe-y->probe;
+        }
+        //e.g. lost and failsafe flag of same frame, qsort is not stable
+        return x->reason-y->reason;
+}
+
+
+//arm dumps on anomalies of block up to end_time in time order, writes dump when post-trigger samples are recorded
+void history_check(history_t *h, int64_t end_time){
+        h->end_time = end_time;
+        qsort(h->anomalies, h->anomalies_n, sizeof(history_anomaly_t), compare_anomalies);
+        for(int i=0;i<h->anomalies_n;i++){
+                history_anomaly_t *a = &h->anomalies[i];
+                //samples up to anomaly are recorded, so dump before it is complete
+                if(h->pending && a->time-h->trigger_time>=h->post){
+                        write_dump(h);
+                }
+                //triggers inside of last dump or pending window are covered by it,
+                //anomaly reported in later block may be earlier than pending trigger
+                bool earlier = h->pending && a->time<h->trigger_time;
+                if(h->dumps<HISTORY_MAX_DUMPS && a->time>=h->dumped_until && (!h->pending || earlier)){
+                        h->pending = true;
+                        h->trigger_time = a->time;
+                        h->trigger_probe = a->probe;
+                        h->trigger_reason = a->reason;
+                }
+        }
+        h->anomalies_n = 0;
+        if(h->pending && end_time-h->trigger_time>=h->post){
+                write_dump(h);
+        }
+}
+
+
+//write pending dump with samples recorded so far, print summary and release history
+void history_close(history_t *h){
+        if(h->pending){
+                write_dump(h);
+        }
+        fprintf(stderr, "triggers:%d dumps:%d\n", h->triggers, h->dumps);
+        for(int i=0;i<32;i++){
+                free(h->probes[i].times);
+        }
+        free(h->edges);
+        free(h->anomalies);
+        free(h);
+}
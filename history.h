@@ -0,0 +1,90 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "edges.h"
+#include "eventlog.h"
+
+//pre-trigger history of decoded probes, dumped as sigrok binary when decoder reports anomaly
+//samples are kept run-length encoded: ring of level change times per probe, so history length
+//depends on edge rate, not on samplerate
+//decoders record anomalies of enabled kinds as events, history takes them from event buffers of block
+//and arms dumps in time order, so dumps do not depend on block size of engine
+
+//trigger kinds
+#define TRIGGER_PARITY 0x01//sbus byte with parity or start bit error
+#define TRIGGER_FRAME 0x02//sbus frame with wrong length, header or footer
+#define TRIGGER_FAILSAFE 0x04//sbus failsafe flag
+#define TRIGGER_LOST 0x08//sbus frame lost flag
+#define TRIGGER_DSHOT 0x10//dshot crc or bit timing error
+#define TRIGGER_WIDTH 0x20//pwm pulse width out of range
+
+//edge times kept for all probes, 8 bytes each
+#define HISTORY_MEMORY (16*1024*1024)
+//files written in one run, later triggers are only counted
+#define HISTORY_MAX_DUMPS 100
+
+//ring of edge times of one probe
+typedef struct history_probe {
+        int64_t *times;
+        uint32_t capacity;
+        uint64_t count;//edges ever added, edge k is at times[k % capacity] while k >= count-capacity
+        int level;//level after newest edge
+} history_probe_t;
+
+//anomaly waiting for check of its block
+typedef struct history_anomaly {
+        int64_t time;
+        int probe;
+        int reason;
+} history_anomaly_t;
+
+typedef struct history {
+        uint32_t probe_mask;
+        int unitsize;
+        int samplerate;//kHz
+        int64_t start_time;//first recorded sample
+        int64_t end_time;//samples before are recorded
+        int64_t pre;//samples kept before trigger
+        int64_t post;//samples recorded after trigger
+        const char *prefix;//dump file prefix
+
+        bool pending;//trigger waits for post-trigger samples
+        int64_t trigger_time;
+        int trigger_probe;
+        int trigger_reason;
+        int64_t dumped_until;//end of last dump, later triggers only
+        int triggers;
+        int dumps;
+
+        history_anomaly_t *anomalies;//added since last check
+        int anomalies_n;
+        int anomalies_capacity;
+
+        edge_detector_t detector;//for history_add_block
+        edge_t *edges;
+        history_probe_t probes[32];
+} history_t;
+
+
+//parse trigger list, e.g. parity,failsafe,width=900-2100 (us), returns 0 on success
+int parse_trigger_list(const char *list, uint32_t *triggers, int *width_min_us, int *width_max_us);
+//name of single trigger kind
+const char *trigger_name(int trigger);
+
+//allocate history of probes, pre and post in samples, returns NULL on error
+history_t *history_open(uint32_t probe_mask, int unitsize, int samplerate, int64_t pre, int64_t post, const char *prefix, int64_t start_time);
+//record edges already extracted by decoder, in time order per probe
+void history_add(history_t *h, const edge_t *edges, int n);
+//extract and record edges of block, block[0] has time base_time
+void history_add_block(history_t *h, const uint8_t *block, size_t samples, int64_t base_time);
+//take anomalies from event buffers of block
+void history_add_events(history_t *h, event_buffer_t **buffers, int buffers_n);
+//arm dumps on anomalies of block up to end_time in time order, writes dump when post-trigger samples are recorded
+void history_check(history_t *h, int64_t end_time);
+//write pending dump with samples recorded so far, print summary and release history
+void history_close(history_t *h);
+
+#endif
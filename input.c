@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "input.h"
+
+
+static int alloc_buffers(input_t *in){
+        for(int i=0;i<2;i++){
+                in->buffers[i] = malloc(in->block_size);
+                if(in->buffers[i]==NULL){
+                        fprintf(stderr, "error allocate input buffer\n");
+                        input_close(in);
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+
+//open input on already opened file descriptor
+int input_open_fd(input_t *in, int fd, size_t block_size){
+        memset(in, 0, sizeof(input_t));
+        in->fd = fd;
+        in->block_size = block_size>0 ? block_size : INPUT_BLOCK_SIZE;
+        in->unitsize = 1;
+
+        struct stat st;
+        if(fstat(fd, &st)!=0){
+                fprintf(stderr, "error stat input %s\n", strerror(errno));
+                return 1;
+        }
+
+        if(S_ISREG(st.st_mode) && st.st_size>0){
+                void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(map!=MAP_FAILED){
+                        madvise(map, st.st_size, MADV_SEQUENTIAL);
+                        in->map = map;
+                        in->map_size = st.st_size;
+                        return 0;
+                }
+                //fallback to read()
+        }
+
+        return alloc_buffers(in);
+}
+
+
+//open sigrok session (.sr) file, metadata is available in in->sr
+int input_open_sr(input_t *in, const char *path, size_t block_size){
+        memset(in, 0, sizeof(input_t));
+        in->fd = -1;
+        in->block_size = block_size>0 ? block_size : INPUT_BLOCK_SIZE;
+        in->sr = sr_open(path);
+        if(in->sr==NULL){
+                return 1;
+        }
+        in->unitsize = in->sr->unitsize;
+        return alloc_buffers(in);
+}
+
+
+//acquire from libsigrok device, driver spec and config as in device_open, metadata is available in in->device
+int input_open_device(input_t *in, const char *spec, const char *config){
+        memset(in, 0, sizeof(input_t));
+        in->fd = -1;
+#ifdef HAVE_LIBSIGROK
+        in->device = device_open(spec, config);
+        if(in->device==NULL){
+                return 1;
+        }
+        in->unitsize = in->device->unitsize;
+        return 0;
+#else
+        (void)spec;
+        (void)config;
+        fprintf(stderr, "built without libsigrok, device acquisition needs make pwm-sigrok\n");
+        return 1;
+#endif
+}
+
+
+//set sample size in bytes, block_size must be multiple of it
+void input_set_unitsize(input_t *in, int unitsize){
+        in->unitsize = unitsize;
+}
+
+
+//get next block of data, returns block length, 0 on eof, -1 on error
+ssize_t input_next_block(input_t *in, const uint8_t **block){
+        if(in->eof){
+                return 0;
+        }
+
+#ifdef HAVE_LIBSIGROK
+        if(in->device!=NULL){
+                ssize_t len = device_next_block(in->device, block);
+                if(len==0){
+                        in->eof = true;
+                }
+                return len;
+        }
+#endif
+        if(in->map!=NULL){
+                size_t len = in->map_size - in->map_pos;
+                if(len>in->block_size){
+                        len = in->block_size;
+                }
+                len -= len % in->unitsize;
+                if(len==0){
+                        in->eof = true;
+                        return 0;
+                }
+                *block = in->map + in->map_pos;
+                in->map_pos += len;
+                return len;
+        }
+
+        //read synchronously into other buffer, previous block stays untouched until next call
+        in->current ^= 1;
+        uint8_t *buffer = in->buffers[in->current];
+
+        if(in->sr!=NULL){
+                ssize_t len = sr_read(in->sr, buffer, in->block_size);
+                if(len<0){
+                        return -1;
+                }
+                len -= len % in->unitsize;
+                if(len==0){
+                        in->eof = true;
+                        return 0;
+                }
+                *block = buffer;
+                return len;
+        }
+        ssize_t r;
+        do {
+                r = read(in->fd, buffer, in->block_size);
+        } while(r<0 && errno==EINTR);
+
+        if(r<0){
+                fprintf(stderr, "error read input %s\n", strerror(errno));
+                return -1;
+        }
+        if(r==0){
+                in->eof = true;
+                return 0;
+        }
+
+        //complete last sample of block
+        while(r % in->unitsize){
+                ssize_t tail = read(in->fd, buffer+r, in->unitsize - r % in->unitsize);
+                if(tail<0 && errno==EINTR){
+                        continue;
+                }
+                if(tail<0){
+                        fprintf(stderr, "error read input %s\n", strerror(errno));
+                        return -1;
+                }
+                if(tail==0){
+                        //drop incomplete sample at the end of stream
+                        in->eof = true;
+                        r -= r % in->unitsize;
+                        break;
+                }
+                r += tail;
+        }
+        if(r==0){
+                return 0;
+        }
+        *block = buffer;
+        return r;
+}
+
+
+//input is memory mapped file
+bool input_is_mapped(input_t *in){
+        return in->map!=NULL;
+}
+
+
+//release buffers/mappings, does not close fd
+void input_close(input_t *in){
+        if(in->map!=NULL){
+                munmap((void*)in->map, in->map_size);
+                in->map = NULL;
+        }
+        for(int i=0;i<2;i++){
+                free(in->buffers[i]);
+                in->buffers[i] = NULL;
+        }
+        sr_close(in->sr);
+        in->sr = NULL;
+#ifdef HAVE_LIBSIGROK
+        device_close(in->device);
+        in->device = NULL;
+#endif
+}
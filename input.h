@@ -0,0 +1,66 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "sr.h"
+#include "device.h"
+
+//default size of one read() block
+#define INPUT_BLOCK_SIZE (1024*1024)
+
+//buffered sample source
+//regular files are mapped into memory, pipes and fifos are read with large blocking read() calls
+//in the caller's thread, alternating between two buffers, so a returned block stays valid
+//for one more input_next_block() call; reads do not overlap decoding
+//sigrok session files are inflated into the same two buffers
+//live libsigrok device passes its packet buffers, only the current block stays valid
+typedef struct input {
+        int fd;
+        size_t block_size;
+        int unitsize;//blocks always hold whole samples
+
+        //mmap mode
+        const uint8_t *map;
+        size_t map_size;
+        size_t map_pos;
+
+        //session file mode
+        sr_file_t *sr;
+
+        //libsigrok acquisition mode
+        device_t *device;
+
+        //read mode
+        uint8_t *buffers[2];
+        int current;
+
+        bool eof;
+} input_t;
+
+
+//open input on already opened file descriptor
+int input_open_fd(input_t *in, int fd, size_t block_size);
+
+//open sigrok session (.sr) file, metadata is available in in->sr
+int input_open_sr(input_t *in, const char *path, size_t block_size);
+
+//acquire from libsigrok device, driver spec and config as in device_open, metadata is available in in->device
+//fails if built without libsigrok
+int input_open_device(input_t *in, const char *spec, const char *config);
+
+//set sample size in bytes, block_size must be multiple of it
+void input_set_unitsize(input_t *in, int unitsize);
+
+//get next block of data, returns block length, 0 on eof, -1 on error
+ssize_t input_next_block(input_t *in, const uint8_t **block);
+
+//input is memory mapped file
+bool input_is_mapped(input_t *in);
+
+//release buffers/mappings, does not close fd (session file is closed)
+void input_close(input_t *in);
+
+#endif
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <getopt.h>
+
+#include "eventlog.h"
+
+//binary event log (pwm -D) to text dump (pwm -d) converter
+
+
+static const char *protocol_name(uint32_t protocol){
+        switch(protocol){
+        case PROTOCOL_PWM:
+                return "pwm";
+        case PROTOCOL_SBUS:
+                return "sbus";
+        case PROTOCOL_DSHOT:
+                return "dshot";
+        case (uint32_t)PROTOCOL_MIXED:
+                return "mixed";
+        }
+        return "unknown";
+}
+
+
+static void show_help(){
+        printf("pwmlog: convert pwm binary event log to text dump form\n");
+        printf(" Usage: pwmlog [-i event_log] [-o text_file] [-p probe] [-v] [-h]\n");
+        printf("  -i  binary log written by pwm -D (default stdin)\n");
+        printf("  -o  text output, same as pwm -d (default stdout)\n");
+        printf("  -p  convert events of one probe only\n");
+        printf("  -v  print log header to stderr\n");
+}
+
+
+int main(int argc, char **argv){
+        FILE *in = stdin;
+        FILE *out = stdout;
+        int probe = -1;
+        int verbose = 0;
+        int ch;
+        while((ch = getopt(argc, argv, "hi:o:p:v")) != -1){
+                switch(ch){
+                case 'h':
+                        show_help();
+                        return 0;
+                case 'i':
+                        in = fopen(optarg, "rb");
+                        if(in==NULL){
+                                fprintf(stderr, "error open %s %s\n", optarg, strerror(errno));
+                                return 1;
+                        }
+                        break;
+                case 'o':
+                        out = fopen(optarg, "w");
+                        if(out==NULL){
+                                fprintf(stderr, "error open %s %s\n", optarg, strerror(errno));
+                                return 1;
+                        }
+                        break;
+                case 'p':
+                        probe = atoi(optarg);
+                        break;
+                case 'v':
+                        verbose = 1;
+                        break;
+                default:
+                        show_help();
+                        return 1;
+                }
+        }
+
+        event_log_header_t header;
+        if(event_log_read_header(in, &header)){
+                return 1;
+        }
+        if(verbose){
+                fprintf(stderr, "samplerate %llu Hz, probes %8.8x, %s\n",
+                        (unsigned long long)header.samplerate, header.probe_mask, protocol_name(header.protocol));
+                if(header.protocol==(uint32_t)PROTOCOL_MIXED){
+                        for(int i=0;i<32;i++){
+                                if(header.probe_mask & (1U<<i)){
+                                        fprintf(stderr, " %d:%s", i, protocol_name(header.protocols[i]));
+                                }
+                        }
+                        fprintf(stderr, "\n");
+                }
+        }
+
+        event_buffer_t buf;
+        memset(&buf, 0, sizeof(buf));
+        dump_event_t event;
+        int r;
+        while((r = event_log_read(in, &buf, &event))>0){
+                if(probe<0 || event.probe==probe){
+                        write_dump_event(out, &buf, &event);
+                }
+        }
+        event_buffer_free(&buf);
+        if(r<0){
+                fprintf(stderr, "error read event log\n");
+                return 1;
+        }
+        if(fclose(out)!=0){
+                fprintf(stderr, "error write output %s\n", strerror(errno));
+                return 1;
+        }
+        return 0;
+}
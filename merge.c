@@ -0,0 +1,450 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+#include "pwm.h"
+#include "merge.h"
+
+
+//parse stream spec path[:samplerate=kHz][:unitsize=n][:offset=us|auto], offset is converted when common samplerate is known
+static int parse_stream(merge_stream_t *s, const char *spec, int default_samplerate, int default_unitsize, double *offset_us){
+        char *copy = strdup(spec);
+        if(copy==NULL){
+                fprintf(stderr, "error allocate input\n");
+                return 1;
+        }
+        s->samplerate = default_samplerate;
+        s->unitsize = default_unitsize>0 ? default_unitsize : 1;
+        *offset_us = 0;
+        char *save;
+        char *path = strtok_r(copy, ":", &save);
+        s->path = strdup(path!=NULL ? path : "");
+        int error = s->path==NULL;
+        for(char *item=strtok_r(NULL, ":", &save);item!=NULL && !error;item=strtok_r(NULL, ":", &save)){
+                char *value = strchr(item, '=');
+                char *end = NULL;
+                if(value==NULL){
+                        error = 1;
+                        break;
+                }
+                *value++ = 0;
+                if(strcmp(item, "samplerate")==0){
+                        s->samplerate = strtol(value, &end, 10);
+                        error = s->samplerate<=0;
+                } else if(strcmp(item, "unitsize")==0){
+                        s->unitsize = strtol(value, &end, 10);
+                        error = s->unitsize!=1 && s->unitsize!=2 && s->unitsize!=4;
+                } else if(strcmp(item, "offset")==0){
+                        if(strcmp(value, "auto")==0){
+                                s->offset_auto = true;
+                                continue;
+                        }
+                        *offset_us = strtod(value, &end);
+                        error = *offset_us<0;
+                } else {
+                        error = 1;
+                }
+                if(end==NULL || *end){
+                        error = 1;
+                }
+        }
+        free(copy);
+        if(error){
+                fprintf(stderr, "invalid input %s, must be path[:samplerate=kHz][:unitsize=n][:offset=us|auto]\n", spec);
+                return 1;
+        }
+        if(s->samplerate<=0){
+                fprintf(stderr, "samplerate of input %s is unknown, set -s or samplerate=\n", s->path);
+                return 1;
+        }
+        return 0;
+}
+
+
+//open streams of specs path[:samplerate=kHz][:unitsize=n][:offset=us|auto], missing samplerate is default_samplerate,
+//missing unitsize is default_unitsize (0 is 1), returns NULL on error
+merge_t *merge_open(char **specs, int specs_n, int default_samplerate, int default_unitsize){
+        if(specs_n>MERGE_MAX_INPUTS){
+                fprintf(stderr, "at most %d inputs are supported\n", MERGE_MAX_INPUTS);
+                return NULL;
+        }
+        merge_t *m = calloc(1, sizeof(merge_t));
+        if(m==NULL){
+                fprintf(stderr, "error allocate inputs\n");
+                return NULL;
+        }
+        double offsets_us[MERGE_MAX_INPUTS];
+        int probes_n = 0;
+        for(int i=0;i<specs_n;i++){
+                merge_stream_t *s = &m->streams[i];
+                s->fd = -1;
+                m->streams_n++;
+                if(parse_stream(s, specs[i], default_samplerate, default_unitsize, &offsets_us[i])){
+                        merge_close(m);
+                        return NULL;
+                }
+                if(sr_is_session_file(s->path)){
+                        fprintf(stderr, "session file %s can not be one of several inputs\n", s->path);
+                        merge_close(m);
+                        return NULL;
+                }
+                s->probe_base = probes_n;
+                probes_n += s->unitsize*8;
+                if(s->samplerate>m->samplerate){
+                        m->samplerate = s->samplerate;
+                }
+        }
+        if(probes_n>MAX_PROBES){
+                fprintf(stderr, "inputs have %d probes, at most %d are supported\n", probes_n, MAX_PROBES);
+                merge_close(m);
+                return NULL;
+        }
+        m->unitsize = probes_n<=8 ? 1 : probes_n<=16 ? 2 : 4;
+        m->max_lag = (int64_t)m->samplerate*MERGE_MAX_LAG_MS;
+
+        for(int i=0;i<m->streams_n;i++){
+                merge_stream_t *s = &m->streams[i];
+                s->offset = (int64_t)(offsets_us[i]*m->samplerate/1000);
+                //fifo open waits for its writer, so reads do not see eof before the writer starts
+                s->fd = strcmp(s->path, "-")==0 ? STDIN_FILENO : open(s->path, O_RDONLY);
+                struct stat st;
+                if(s->fd<0 || fstat(s->fd, &st)!=0 || fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL) | O_NONBLOCK)!=0){
+                        fprintf(stderr, "error open %s %s\n", s->path, strerror(errno));
+                        merge_close(m);
+                        return NULL;
+                }
+                s->regular = S_ISREG(st.st_mode);
+                if(!s->regular){
+                        m->live = true;
+                }
+                s->buffer = malloc(INPUT_BLOCK_SIZE);
+                if(s->buffer==NULL){
+                        fprintf(stderr, "error allocate input buffer\n");
+                        merge_close(m);
+                        return NULL;
+                }
+        }
+        return m;
+}
+
+
+//global probe mask of all stream probes
+uint32_t merge_probe_mask(merge_t *m){
+        uint32_t mask = 0;
+        for(int i=0;i<m->streams_n;i++){
+                merge_stream_t *s = &m->streams[i];
+                uint32_t unit_mask = s->unitsize==4 ? 0xFFFFFFFF : (1U<<(s->unitsize*8))-1;
+                mask |= unit_mask<<s->probe_base;
+        }
+        return mask;
+}
+
+
+//stream sample time on common time base
+static inline int64_t common_time(merge_t *m, merge_stream_t *s, int64_t time){
+        if(s->samplerate==m->samplerate){
+                return s->offset+time;
+        }
+        return s->offset+time*m->samplerate/s->samplerate;
+}
+
+
+//common time up to which stream samples are read, INT64_MAX after eof, -1 if not started
+static int64_t stream_end(merge_t *m, merge_stream_t *s){
+        if(s->eof){
+                return INT64_MAX;
+        }
+        if(!s->started){
+                return -1;
+        }
+        return common_time(m, s, s->samples);
+}
+
+
+//read available data of stream and queue its edges, returns 0 on success
+static int read_stream(merge_t *m, merge_stream_t *s){
+        ssize_t n = read(s->fd, s->buffer+s->fill, INPUT_BLOCK_SIZE-s->fill);
+        if(n<0){
+                if(errno==EAGAIN || errno==EINTR){
+                        return 0;
+                }
+                fprintf(stderr, "error read %s %s\n", s->path, strerror(errno));
+                return 1;
+        }
+        if(n==0){
+                s->eof = true;
+                return 0;
+        }
+        if(!s->started){
+                int64_t now = monitor_now();
+                s->first_ns = now;
+                if(m->first_ns==0){
+                        m->first_ns = now;
+                }
+                if(s->offset_auto){
+                        //stream started later than first one
+                        s->offset = (now-m->first_ns)*m->samplerate/1000000;
+                }
+                s->started = true;
+        }
+        s->bytes += n;
+        s->fill += n;
+
+        size_t samples = s->fill/s->unitsize;
+        size_t pos = 0;
+        while(pos<samples){
+                if(s->capacity-s->edges_n<EDGE_BUFFER_SIZE && s->edges_pos>0){
+                        //drop decoded edges, then grow
+                        memmove(s->edges, s->edges+s->edges_pos, (s->edges_n-s->edges_pos)*sizeof(edge_t));
+                        s->edges_n -= s->edges_pos;
+                        s->edges_pos = 0;
+                }
+                if(s->capacity-s->edges_n<EDGE_BUFFER_SIZE){
+                        int capacity = s->capacity ? s->capacity*2 : EDGE_BUFFER_SIZE*2;
+                        edge_t *edges = realloc(s->edges, capacity*sizeof(edge_t));
+                        if(edges==NULL){
+                                fprintf(stderr, "error allocate edges\n");
+                                return 1;
+                        }
+                        s->edges = edges;
+                        s->capacity = capacity;
+                }
+                edge_t *edges = s->edges+s->edges_n;
+                int k = extract_edges(&s->detector, s->unitsize, s->buffer, samples, &pos, s->samples, edges, EDGE_BUFFER_SIZE);
+                for(int e=0;e<k;e++){
+                        edges[e].time = common_time(m, s, edges[e].time);
+                        edges[e].probe += s->probe_base;
+                }
+                s->edges_n += k;
+                s->edges_total += k;
+        }
+        s->samples += samples;
+        //partial sample waits for rest of its bytes
+        size_t used = samples*s->unitsize;
+        memmove(s->buffer, s->buffer+used, s->fill-used);
+        s->fill -= used;
+        return 0;
+}
+
+
+//common time up to which all streams are read, -1 if some stream did not start yet
+static int64_t merge_watermark(merge_t *m){
+        int64_t until = INT64_MAX;
+        for(int i=0;i<m->streams_n;i++){
+                int64_t end = stream_end(m, &m->streams[i]);
+                if(end<until){
+                        until = end;
+                }
+        }
+        if(until==INT64_MAX){
+                //all streams ended, capture ends with longest one
+                until = 0;
+                for(int i=0;i<m->streams_n;i++){
+                        merge_stream_t *s = &m->streams[i];
+                        int64_t end = s->started ? common_time(m, s, s->samples) : 0;
+                        if(end>until){
+                                until = end;
+                        }
+                }
+        }
+        return until;
+}
+
+
+//decode queued edges of all streams before until, in time order
+static void merge_decode(context_t *ctx, merge_t *m, decoder_t *dec, int64_t until){
+        for(;;){
+                int n = 0;
+                while(n<EDGE_BUFFER_SIZE){
+                        merge_stream_t *best = NULL;
+                        for(int i=0;i<m->streams_n;i++){
+                                merge_stream_t *s = &m->streams[i];
+                                if(s->edges_pos<s->edges_n && s->edges[s->edges_pos].time<until &&
+                                   (best==NULL || s->edges[s->edges_pos].time<best->edges[best->edges_pos].time)){
+                                        best = s;
+                                }
+                        }
+                        if(best==NULL){
+                                break;
+                        }
+                        dec->edges[n++] = best->edges[best->edges_pos++];
+                }
+                if(n==0){
+                        break;
+                }
+                dec->edges_n += n;
+                if(history!=NULL){
+                        history_add(history, dec->edges, n);
+                }
+                decode_edges(ctx, dec->edges, n);
+        }
+        decode_end(ctx, dec, until);
+}
+
+
+//pause streams too far ahead of slowest one, resume them when it caught up
+static void update_pauses(merge_t *m, int64_t until){
+        int64_t now = monitor_now();
+        for(int i=0;i<m->streams_n;i++){
+                merge_stream_t *s = &m->streams[i];
+                if(!s->started || s->eof){
+                        continue;
+                }
+                int64_t lag = stream_end(m, s)-until;
+                if(lag>s->max_lag){
+                        s->max_lag = lag;
+                }
+                bool ahead = lag>m->max_lag || s->edges_n-s->edges_pos>MERGE_MAX_EDGES;
+                if(ahead && !s->paused){
+                        s->paused = true;
+                        s->overruns++;
+                        s->pause_start_ns = now;
+                } else if(!ahead && s->paused){
+                        s->paused = false;
+                        s->paused_ns += now-s->pause_start_ns;
+                }
+        }
+}
+
+
+//decode streams up to until and write outputs of decoded part
+static void merge_output(context_t *ctx, merge_t *m, decoder_t *dec, display_t *display, int64_t *time, int64_t until, int64_t arrival){
+        event_buffer_t *events = &dec->events;
+        int64_t t = monitor_now();
+        merge_decode(ctx, m, dec, until);
+        ctx->line_num += until-*time;
+        t = monitor_stage(monitor, STAGE_DECODE, t);
+        if(dump_enabled || history!=NULL){
+                output_events(&events, 1);
+        }
+        event_buffer_clear(events);
+        if(history!=NULL){
+                history_check(history, until);
+        }
+        if(display_wanted(display)){
+                ctx->edges_n = dec->edges_n;
+                display_publish(display, ctx);
+        }
+        if(telemetry!=NULL){
+                ctx->edges_n = dec->edges_n;
+                telemetry_publish(telemetry, ctx);
+        }
+        monitor_stage(monitor, STAGE_OUTPUT, t);
+        monitor_block(monitor, arrival, until-*time, dec->edges_n, count_frames(ctx->probes, ctx->probes_n));
+        *time = until;
+}
+
+
+//process several streams on common time base, display may be NULL
+int process_data_merged(context_t *ctx, merge_t *m, display_t *display){
+        if(init_probes(ctx, 31-__builtin_clz(ctx->probe_mask))){
+                return 1;
+        }
+        decoder_t *decoder = malloc(sizeof(decoder_t));
+        if(decoder==NULL){
+                fprintf(stderr, "error allocate decoder\n");
+                return 1;
+        }
+        init_decoder(decoder, ctx, ctx->probe_mask);
+        for(int i=0;i<m->streams_n;i++){
+                merge_stream_t *s = &m->streams[i];
+                uint32_t unit_mask = s->unitsize==4 ? 0xFFFFFFFF : (1U<<(s->unitsize*8))-1;
+                init_edge_detector(&s->detector, (ctx->probe_mask>>s->probe_base) & unit_mask);
+        }
+
+        m->start_ns = monitor_now();
+        int error = 0;
+        int64_t time = 0;//decoded up to
+        struct pollfd fds[MERGE_MAX_INPUTS];
+        merge_stream_t *polled[MERGE_MAX_INPUTS];
+        for(;;){
+                int n = 0;
+                for(int i=0;i<m->streams_n;i++){
+                        merge_stream_t *s = &m->streams[i];
+                        if(!s->eof && !s->paused){
+                                fds[n].fd = s->fd;
+                                fds[n].events = POLLIN;
+                                polled[n++] = s;
+                        }
+                }
+                if(n==0){
+                        break;
+                }
+                int64_t t = monitor_now();
+                if(poll(fds, n, -1)<0){
+                        if(errno==EINTR){
+                                continue;
+                        }
+                        fprintf(stderr, "error poll inputs %s\n", strerror(errno));
+                        error = 1;
+                        break;
+                }
+                for(int i=0;i<n && !error;i++){
+                        if(fds[i].revents){
+                                error = read_stream(m, polled[i]);
+                        }
+                }
+                if(error){
+                        break;
+                }
+                int64_t arrival = monitor_stage(monitor, STAGE_READ, t);
+                int64_t until = merge_watermark(m);
+                if(until>time){
+                        merge_output(ctx, m, decoder, display, &time, until, arrival);
+                }
+                update_pauses(m, time);
+        }
+        if(!error){
+                int64_t until = merge_watermark(m);
+                if(until>time){
+                        merge_output(ctx, m, decoder, display, &time, until, monitor_now());
+                }
+        }
+        m->end_ns = monitor_now();
+        ctx->edges_n = decoder->edges_n;
+        free_decoder(decoder);
+        free(decoder);
+        return error;
+}
+
+
+//print per-stream samplerate, alignment, rate and overrun counters
+void dump_merge(merge_t *m){
+        for(int i=0;i<m->streams_n;i++){
+                merge_stream_t *s = &m->streams[i];
+                double seconds = s->first_ns>0 ? (m->end_ns-s->first_ns)/1e9 : 0;
+                int64_t paused_ns = s->paused_ns + (s->paused ? m->end_ns-s->pause_start_ns : 0);
+                printf("input %d: %s samplerate:%dk probes:%d-%d offset:%.3fms samples:%lld edges:%lld rate:%.3f MSamples/s\n",
+                       i, s->path, s->samplerate, s->probe_base, s->probe_base+s->unitsize*8-1, s->offset/(double)m->samplerate,
+                       (long long)s->samples, s->edges_total, seconds>0 ? s->samples/seconds/1e6 : 0);
+                printf("input %d: overruns:%d paused:%.1fms max_lag:%.1fms", i, s->overruns, paused_ns/1e6, s->max_lag/(double)m->samplerate);
+                if(s->fill>0){
+                        //trailing bytes of incomplete sample are not decoded
+                        printf(" partial:%zu bytes", s->fill);
+                }
+                printf("\n");
+        }
+}
+
+
+void merge_close(merge_t *m){
+        if(m==NULL){
+                return;
+        }
+        for(int i=0;i<m->streams_n;i++){
+                merge_stream_t *s = &m->streams[i];
+                if(s->fd>=0 && s->fd!=STDIN_FILENO){
+                        close(s->fd);
+                }
+                free(s->path);
+                free(s->buffer);
+                free(s->edges);
+        }
+        free(m);
+}
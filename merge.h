@@ -0,0 +1,79 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "edges.h"
+
+//several sample streams (fifos or files, e.g. one sigrok-cli per analyzer) decoded as one capture
+//streams are read with non-blocking reads multiplexed by poll(), every stream has own samplerate and
+//unitsize, its probes are numbered after probes of previous streams
+//edges of every stream are converted to common time base (highest samplerate) and stream offset,
+//then decoded in time order up to the end of the slowest stream, so dump and display are common
+//stream too far ahead of the slowest one is not read until others catch up, its producer may then
+//overrun, pauses are counted per stream
+
+#define MERGE_MAX_INPUTS 4
+//stream is paused when it is ahead of slowest stream by more
+#define MERGE_MAX_LAG_MS 1000
+//or when so many of its edges wait for other streams
+#define MERGE_MAX_EDGES (4*1024*1024)
+
+typedef struct merge_stream {
+        char *path;
+        int fd;
+        bool regular;//regular file, not fifo or pipe
+        int samplerate;//kHz
+        int unitsize;
+        int probe_base;//global number of stream probe 0
+        int64_t offset;//common time of stream sample 0
+        bool offset_auto;//offset from arrival of first data
+        bool started;//offset is known
+        bool eof;
+        bool paused;
+
+        uint8_t *buffer;
+        size_t fill;//bytes in buffer, partial sample is kept for next read
+        edge_detector_t detector;
+        int64_t samples;//samples read
+
+        //converted edges waiting for slower streams
+        edge_t *edges;
+        int edges_n;
+        int edges_pos;//next edge to decode
+        int capacity;
+
+        //accounting
+        uint64_t bytes;
+        long long edges_total;
+        int overruns;//pauses because stream was ahead
+        int64_t paused_ns;
+        int64_t pause_start_ns;
+        int64_t max_lag;//common samples ahead of slowest stream
+        int64_t first_ns;//arrival of first data
+} merge_stream_t;
+
+typedef struct merge {
+        merge_stream_t streams[MERGE_MAX_INPUTS];
+        int streams_n;
+        int samplerate;//common time base, kHz
+        int unitsize;//bytes of all stream probes, 1, 2 or 4
+        bool live;//some stream is not regular file
+        int64_t max_lag;//common samples
+        int64_t first_ns;//first data of any stream
+        int64_t start_ns;
+        int64_t end_ns;
+} merge_t;
+
+
+//open streams of specs path[:samplerate=kHz][:unitsize=n][:offset=us|auto], missing samplerate is default_samplerate,
+//missing unitsize is default_unitsize (0 is 1), returns NULL on error
+merge_t *merge_open(char **specs, int specs_n, int default_samplerate, int default_unitsize);
+//global probe mask of all stream probes
+uint32_t merge_probe_mask(merge_t *m);
+//print per-stream samplerate, alignment, rate and overrun counters
+void dump_merge(merge_t *m);
+void merge_close(merge_t *m);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "monitor.h"
+
+
+//init counters, samplerate in kHz, returns 0 on success
+int monitor_init(monitor_t *m, int samplerate, bool live, int interval_ms, FILE *out){
+        memset(m, 0, sizeof(monitor_t));
+        m->samplerate = samplerate;
+        m->live = live;
+        m->interval_ms = interval_ms;
+        m->out = out;
+        m->start_ns = monitor_now();
+        m->window_ns = m->start_ns;
+        m->line_ns = m->start_ns;
+        return init_histogram(&m->latency);
+}
+
+
+void monitor_free(monitor_t *m){
+        free_histogram(&m->latency);
+}
+
+
+//rate of samples over ns, MSamples/s
+static double rate_msps(uint64_t samples, int64_t ns){
+        return ns>0 ? samples*1e3/ns : 0;
+}
+
+
+//print machine readable stats line: key=value pairs, rates over last interval, times since start
+static void monitor_line(monitor_t *m, int64_t now, uint64_t edges, uint64_t frames){
+        int64_t ns = now-m->line_ns;
+        double seconds = ns/1e9;
+        fprintf(m->out, "stats time=%.3f samples=%llu rate=%.3f nominal=%.3f edges=%llu edge_rate=%.0f frames=%llu frame_rate=%.1f",
+                (now-m->start_ns)/1e9, (unsigned long long)m->samples,
+                rate_msps(m->samples-m->line_samples, ns), m->samplerate/1e3,
+                (unsigned long long)edges, (edges-m->line_edges)/seconds,
+                (unsigned long long)frames, (frames-m->line_frames)/seconds);
+        fprintf(m->out, " read_ms=%.1f decode_ms=%.1f output_ms=%.1f",
+                __atomic_load_n(&m->stage_ns[STAGE_READ], __ATOMIC_RELAXED)/1e6,
+                __atomic_load_n(&m->stage_ns[STAGE_DECODE], __ATOMIC_RELAXED)/1e6,
+                __atomic_load_n(&m->stage_ns[STAGE_OUTPUT], __ATOMIC_RELAXED)/1e6);
+        fprintf(m->out, " latency_p50_us=%.0f latency_p99_us=%.0f latency_max_us=%d underruns=%d\n",
+                histogram_percentile(&m->latency, 50), histogram_percentile(&m->latency, 99),
+                m->latency.max_value, m->underruns);
+        fflush(m->out);
+        m->line_ns = now;
+        m->line_samples = m->samples;
+        m->line_edges = edges;
+        m->line_frames = frames;
+}
+
+
+//output of samples, which arrived at arrival_ns, is written
+//checks input rate and prints stats line when interval is over, edges and frames are totals so far
+void monitor_block(monitor_t *m, int64_t arrival_ns, uint64_t samples, uint64_t edges, uint64_t frames){
+        int64_t now = monitor_now();
+        int64_t latency = (now-arrival_ns)/1000;
+        histogram_add(&m->latency, latency>INT32_MAX ? INT32_MAX : latency);
+        m->samples += samples;
+
+        if(m->live && m->samplerate>0 && now-m->window_ns>=MONITOR_WINDOW_MS*1000000LL){
+                //first window includes acquisition start
+                double rate = rate_msps(m->samples-m->window_samples, now-m->window_ns);
+                bool underrun = m->window_samples>0 && rate<m->samplerate/1e3*MONITOR_UNDERRUN_RATIO;
+                if(underrun){
+                        m->underruns++;
+                        if(!m->underrun){
+                                fprintf(stderr, "warning: input rate %.3f MSamples/s is below samplerate %.3f MSamples/s\n",
+                                        rate, m->samplerate/1e3);
+                        }
+                }
+                m->underrun = underrun;
+                m->window_ns = now;
+                m->window_samples = m->samples;
+        }
+        if(m->interval_ms>0 && now-m->line_ns>=m->interval_ms*1000000LL){
+                monitor_line(m, now, edges, frames);
+        }
+}
+
+
+//print summary of stage times, latency and underruns
+void dump_monitor(monitor_t *m){
+        printf("stages: read:%.1fms decode:%.1fms output:%.1fms\n",
+               m->stage_ns[STAGE_READ]/1e6, m->stage_ns[STAGE_DECODE]/1e6, m->stage_ns[STAGE_OUTPUT]/1e6);
+        histogram_t *h = &m->latency;
+        if(h->total>0){
+                printf("latency: blocks:%llu p50:%.0fus p99:%.0fus p99.9:%.0fus max:%dus\n", (unsigned long long)h->total,
+                       histogram_percentile(h, 50), histogram_percentile(h, 99), histogram_percentile(h, 99.9), h->max_value);
+        }
+        if(m->live && m->samplerate>0){
+                double seconds = (monitor_now()-m->start_ns)/1e9;
+                printf("input: rate:%.3f nominal:%.3f MSamples/s underruns:%d\n",
+                       seconds>0 ? m->samples/seconds/1e6 : 0, m->samplerate/1e3, m->underruns);
+        }
+}
@@ -0,0 +1,76 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "histogram.h"
+
+//runtime counters of processing loop: ingest rate against nominal samplerate, time per stage,
+//block arrival to written output latency and input underruns
+//stage times are added by the thread running the stage, everything else by output stage only
+
+//processing stages
+#define STAGE_READ 0//reading input, waiting for data
+#define STAGE_DECODE 1//edge extraction and decoding, summed over decoder threads
+#define STAGE_OUTPUT 2//dump and log writing, display snapshots
+#define STAGES 3
+
+//input rate is checked over windows of this length
+#define MONITOR_WINDOW_MS 1000
+//window rate below this part of nominal samplerate is underrun
+#define MONITOR_UNDERRUN_RATIO 0.98
+
+typedef struct monitor {
+        int samplerate;//nominal, kHz, 0 if unknown
+        bool live;//stream input, rate is limited by source and checked against samplerate
+        int interval_ms;//stats line period, 0 if off
+        FILE *out;//stats lines
+
+        int64_t start_ns;
+        uint64_t samples;//samples with written output
+        uint64_t stage_ns[STAGES];
+        histogram_t latency;//us
+
+        //rate window
+        int64_t window_ns;
+        uint64_t window_samples;
+        int underruns;//windows with input rate below nominal
+        bool underrun;//last window was underrun
+
+        //stats line
+        int64_t line_ns;
+        uint64_t line_samples;
+        uint64_t line_edges;
+        uint64_t line_frames;
+} monitor_t;
+
+
+static inline int64_t monitor_now(){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+//add time since start to stage, returns current time
+static inline int64_t monitor_stage(monitor_t *m, int stage, int64_t start){
+        int64_t now = monitor_now();
+        __atomic_fetch_add(&m->stage_ns[stage], now-start, __ATOMIC_RELAXED);
+        return now;
+}
+
+
+//init counters, samplerate in kHz, returns 0 on success
+int monitor_init(monitor_t *m, int samplerate, bool live, int interval_ms, FILE *out);
+void monitor_free(monitor_t *m);
+
+//output of samples, which arrived at arrival_ns, is written
+//checks input rate and prints stats line when interval is over, edges and frames are totals so far
+void monitor_block(monitor_t *m, int64_t arrival_ns, uint64_t samples, uint64_t edges, uint64_t frames);
+
+//print summary of stage times, latency and underruns
+void dump_monitor(monitor_t *m);
+
+#endif
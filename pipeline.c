@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "pwm.h"
+
+//multithreaded processing:
+//reader thread -> ring of sample blocks -> decoder threads (each owns subset of probes) -> output stage (caller thread)
+//ring indices are single-writer counters, every stage waits only on the counters of previous stage
+
+#define RING_SLOTS 16
+#define SLOT_SIZE (256*1024)
+
+typedef struct ring_slot {
+        const uint8_t *data;//samples, points into mapped input or to buffer
+        uint8_t *buffer;
+        size_t samples;
+        int64_t base_time;
+        int64_t arrival_ns;//block was read
+        long long edges;//edges of slot, summed over decoder threads
+
+        event_buffer_t *events;//dump events, one buffer per decoder thread
+        probe_data_t snapshot[MAX_PROBES];//probes state after this block, for display
+        int done;//decoder threads finished with slot
+} ring_slot_t;
+
+struct pipeline;
+
+typedef struct worker {
+        struct pipeline *p;
+        int idx;
+        decoder_t *decoder;
+        pthread_t thread;
+} worker_t;
+
+typedef struct pipeline {
+        context_t *ctx;
+        input_t *in;
+        int workers_n;
+        worker_t *workers;
+        context_t *view;//context published to display and telemetry, probes from slot snapshots
+
+        ring_slot_t slots[RING_SLOTS];
+        unsigned long head;//slots filled by reader
+        unsigned long tail;//slots released by output stage
+        int finished;//reader reached end of input
+        int error;
+} pipeline_t;
+
+
+//wait step: spin a bit, then sleep
+static void backoff(int *spins){
+        if(*spins<64){
+                (*spins)++;
+                sched_yield();
+                return;
+        }
+        struct timespec ts = {0, 50000};
+        nanosleep(&ts, NULL);
+}
+
+
+//reader thread, splits input blocks into ring slots
+static void *reader_thread(void *arg){
+        pipeline_t *p = arg;
+        int unitsize = p->ctx->unitsize;
+        unsigned long head = 0;
+        int64_t base_time = 0;
+        const uint8_t *block;
+        ssize_t len;
+        int64_t t = monitor_now();
+        while((len=input_next_block(p->in, &block))>0){
+                int64_t arrival = monitor_stage(monitor, STAGE_READ, t);
+                size_t offset = 0;
+                while(offset<(size_t)len){
+                        int spins = 0;
+                        while(head-__atomic_load_n(&p->tail, __ATOMIC_ACQUIRE)>=RING_SLOTS){
+                                backoff(&spins);
+                        }
+                        ring_slot_t *slot = &p->slots[head % RING_SLOTS];
+                        size_t size = len-offset;
+                        if(size>SLOT_SIZE){
+                                size = SLOT_SIZE;
+                        }
+                        if(input_is_mapped(p->in)){
+                                //mapping stays valid until input is closed
+                                slot->data = block+offset;
+                        }else{
+                                memcpy(slot->buffer, block+offset, size);
+                                slot->data = slot->buffer;
+                        }
+                        slot->samples = size/unitsize;
+                        slot->base_time = base_time;
+                        slot->arrival_ns = arrival;
+                        slot->edges = 0;
+                        base_time += slot->samples;
+                        offset += size;
+                        head++;
+                        __atomic_store_n(&p->head, head, __ATOMIC_RELEASE);
+                }
+                t = monitor_now();
+        }
+        if(len<0){
+                p->error = 1;
+        }
+        __atomic_store_n(&p->finished, 1, __ATOMIC_RELEASE);
+        return NULL;
+}
+
+
+//decoder thread, decodes own probes on every slot
+static void *worker_thread(void *arg){
+        worker_t *w = arg;
+        pipeline_t *p = w->p;
+        context_t *ctx = p->ctx;
+        uint32_t mask = w->decoder->probe_mask;
+        unsigned long next = 0;
+        for(;;){
+                int spins = 0;
+                while(next>=__atomic_load_n(&p->head, __ATOMIC_ACQUIRE)){
+                        if(__atomic_load_n(&p->finished, __ATOMIC_ACQUIRE) &&
+                           next>=__atomic_load_n(&p->head, __ATOMIC_ACQUIRE)){
+                                return NULL;
+                        }
+                        backoff(&spins);
+                }
+                ring_slot_t *slot = &p->slots[next % RING_SLOTS];
+
+                //route dump events of own probes into slot
+                uint32_t probes = mask;
+                while(probes){
+                        int probe_idx = __builtin_ctz(probes);
+                        ctx->probes[probe_idx].events = &slot->events[w->idx];
+                        probes &= probes-1;
+                }
+
+                int64_t t = monitor_now();
+                long long edges_n = w->decoder->edges_n;
+                decode_block(ctx, w->decoder, slot->data, slot->samples, slot->base_time);
+                __atomic_fetch_add(&slot->edges, w->decoder->edges_n-edges_n, __ATOMIC_RELAXED);
+                monitor_stage(monitor, STAGE_DECODE, t);
+
+                probes = mask;
+                while(probes){
+                        int probe_idx = __builtin_ctz(probes);
+                        slot->snapshot[probe_idx] = ctx->probes[probe_idx];
+                        probes &= probes-1;
+                }
+                __atomic_fetch_add(&slot->done, 1, __ATOMIC_ACQ_REL);
+                next++;
+        }
+}
+
+
+static void free_pipeline(pipeline_t *p){
+        for(int i=0;i<RING_SLOTS;i++){
+                ring_slot_t *slot = &p->slots[i];
+                free(slot->buffer);
+                if(slot->events!=NULL){
+                        for(int w=0;w<p->workers_n;w++){
+                                event_buffer_free(&slot->events[w]);
+                        }
+                        free(slot->events);
+                }
+        }
+        if(p->workers!=NULL){
+                for(int w=0;w<p->workers_n;w++){
+                        if(p->workers[w].decoder!=NULL){
+                                free_decoder(p->workers[w].decoder);
+                                free(p->workers[w].decoder);
+                        }
+                }
+                free(p->workers);
+        }
+        free(p->view);
+        for(int i=0;i<p->ctx->probes_n;i++){
+                p->ctx->probes[i].events = NULL;
+        }
+        free(p);
+}
+
+
+//process incoming data with reader, decoder and output threads
+int process_data_threaded(context_t *ctx, input_t *in, display_t *display, int threads){
+        if(init_probes(ctx, 31-__builtin_clz(ctx->probe_mask))){
+                return 1;
+        }
+
+        //no more decoders than probes
+        int probes_count = __builtin_popcount(ctx->probe_mask);
+        if(threads>probes_count){
+                threads = probes_count;
+        }
+
+        pipeline_t *p = calloc(1, sizeof(pipeline_t));
+        if(p==NULL){
+                fprintf(stderr, "error allocate pipeline\n");
+                return 1;
+        }
+        p->ctx = ctx;
+        p->in = in;
+        p->workers_n = threads;
+        p->workers = calloc(threads, sizeof(worker_t));
+        p->view = malloc(sizeof(context_t));
+        if(p->workers==NULL || p->view==NULL){
+                fprintf(stderr, "error allocate pipeline\n");
+                free_pipeline(p);
+                return 1;
+        }
+        *p->view = *ctx;
+
+        for(int i=0;i<RING_SLOTS;i++){
+                ring_slot_t *slot = &p->slots[i];
+                slot->events = calloc(threads, sizeof(event_buffer_t));
+                slot->buffer = input_is_mapped(in) ? NULL : malloc(SLOT_SIZE);
+                if(slot->events==NULL || (!input_is_mapped(in) && slot->buffer==NULL)){
+                        fprintf(stderr, "error allocate pipeline\n");
+                        free_pipeline(p);
+                        return 1;
+                }
+        }
+
+        //deal probes round-robin to decoders
+        uint32_t masks[MAX_PROBES] = {0};
+        uint32_t probes = ctx->probe_mask;
+        for(int i=0;probes;i++){
+                int probe_idx = __builtin_ctz(probes);
+                masks[i % threads] |= 1U<<probe_idx;
+                probes &= probes-1;
+        }
+        for(int w=0;w<threads;w++){
+                p->workers[w].p = p;
+                p->workers[w].idx = w;
+                p->workers[w].decoder = malloc(sizeof(decoder_t));
+                if(p->workers[w].decoder==NULL){
+                        fprintf(stderr, "error allocate decoder\n");
+                        free_pipeline(p);
+                        return 1;
+                }
+                init_decoder(p->workers[w].decoder, ctx, masks[w]);
+        }
+
+        //decoders first, so failure does not leave reader running
+        int started;
+        int r = 0;
+        for(started=0;started<threads;started++){
+                r = pthread_create(&p->workers[started].thread, NULL, worker_thread, &p->workers[started]);
+                if(r!=0){
+                        break;
+                }
+        }
+        pthread_t reader;
+        if(r==0){
+                r = pthread_create(&reader, NULL, reader_thread, p);
+        }
+        if(r!=0){
+                fprintf(stderr, "error create thread %s\n", strerror(r));
+                __atomic_store_n(&p->finished, 1, __ATOMIC_RELEASE);
+                for(int w=0;w<started;w++){
+                        pthread_join(p->workers[w].thread, NULL);
+                }
+                free_pipeline(p);
+                return 1;
+        }
+
+        //output stage: release slots in order when all decoders are done
+        event_buffer_t *buffers[MAX_PROBES];
+        context_t *view = p->view;
+        unsigned long tail = 0;
+        for(;;){
+                int spins = 0;
+                bool finished = false;
+                while(tail>=__atomic_load_n(&p->head, __ATOMIC_ACQUIRE)){
+                        if(__atomic_load_n(&p->finished, __ATOMIC_ACQUIRE) &&
+                           tail>=__atomic_load_n(&p->head, __ATOMIC_ACQUIRE)){
+                                finished = true;
+                                break;
+                        }
+                        backoff(&spins);
+                }
+                if(finished){
+                        break;
+                }
+                ring_slot_t *slot = &p->slots[tail % RING_SLOTS];
+                spins = 0;
+                while(__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE)<threads){
+                        backoff(&spins);
+                }
+
+                int64_t t = monitor_now();
+                ctx->edges_n += slot->edges;
+                if(dump_enabled || history!=NULL){
+                        for(int w=0;w<threads;w++){
+                                buffers[w] = &slot->events[w];
+                        }
+                        output_events(buffers, threads);
+                }
+                for(int w=0;w<threads;w++){
+                        event_buffer_clear(&slot->events[w]);
+                }
+                ctx->line_num += slot->samples;
+                if(history!=NULL){
+                        //decoders do not share edges, slot samples are scanned again off the decode path
+                        history_add_block(history, slot->data, slot->samples, slot->base_time);
+                        history_check(history, slot->base_time+slot->samples);
+                }
+
+                bool wanted = display_wanted(display);
+                if(wanted || telemetry!=NULL){
+                        //configuration was copied at start, decoded probes are taken from slot snapshot,
+                        //live state is owned by decoders
+                        view->max_time = ctx->max_time;
+                        view->line_num = ctx->line_num;
+                        view->edges_n = ctx->edges_n;
+                        for(int i=0;i<ctx->probes_n;i++){
+                                if(ctx->probe_mask & (1U<<i)){
+                                        view->probes[i] = slot->snapshot[i];
+                                }else{
+                                        view->probes[i] = ctx->probes[i];
+                                }
+                        }
+                        if(wanted){
+                                display_publish(display, view);
+                        }
+                        if(telemetry!=NULL){
+                                telemetry_publish(telemetry, view);
+                        }
+                }
+                monitor_stage(monitor, STAGE_OUTPUT, t);
+                monitor_block(monitor, slot->arrival_ns, slot->samples, ctx->edges_n, count_frames(slot->snapshot, ctx->probes_n));
+
+                __atomic_store_n(&slot->done, 0, __ATOMIC_RELAXED);
+                tail++;
+                __atomic_store_n(&p->tail, tail, __ATOMIC_RELEASE);
+        }
+        pthread_join(reader, NULL);
+        for(int w=0;w<threads;w++){
+                pthread_join(p->workers[w].thread, NULL);
+        }
+
+        int error = p->error;
+        free_pipeline(p);
+        return error;
+}
@@ -10,10 +10,12 @@
 #include <limits.h>
 #include <getopt.h>
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "pwm.h"
 
 #define BUFFER_SIZE 160
-#define MAX_PROBES 16
-#define AVERAGER_SIZE 400
 
 //window size for averaging
 int average_n = 10;//0.025s * 400 Hz
@@ -21,169 +23,20 @@ int average_n = 10;//0.025s * 400 Hz
 int verbose = 0;
 int debug_bitstream = 0;
 FILE *dump_file = NULL;
+event_log_t *event_log = NULL;
+value_store_t *value_store = NULL;
+bool dump_enabled = false;
+edge_index_writer_t *edge_index = NULL;
+monitor_t *monitor = NULL;
+telemetry_writer_t *telemetry = NULL;
+history_t *history = NULL;
 
 #define DETAIL 10
 
-//average calculation struct
-//uses circular buffer and calculates average, median and root-square-mean deviation
-typedef struct average_data {
-        int data_count;
-        int circular_index;
-        int buffer[AVERAGER_SIZE];
-
-        double average;
-        double rmsd;
-
-        int last_value;
-        int median;
-        int min_value;
-        int max_value;
-        int min_value_filtered;
-        int max_value_filtered;
-} average_data_t;
-
-
-//init averaging structure
-void init_average(average_data_t *avg){
-        memset(avg, 0, sizeof(average_data_t));
-        avg->min_value = INT_MAX;
-        avg->max_value = INT_MIN;
-        avg->min_value_filtered = INT_MAX;
-        avg->max_value_filtered = INT_MIN;
-}
-
-
-int min(int a, int b) {
-    if (a > b)
-        return b;
-    return a;
-}
-
-int max(int a, int b) {
-    if (a < b)
-        return b;
-    return a;
-}
-
-
-//qsort comparer for median filter
-int cmp_int(const void *p1, const void *p2){
-        return (*(int*)p1)-(*(int*)p2);
-}
-
-
-//calculate averages for array of 'size' ints
-void update_average_from_array(average_data_t *avg, int* array, int size){
-        double average = 0;
-        for(int i=0;i<size;i++){
-                average+=array[i];
-        }
-        avg->average = average/size;
-
-        double rmsd = 0;
-        for(int i=0;i<size;i++){
-                double tmp = array[i]-avg->average;
-                rmsd+=tmp*tmp;
-        }
-        avg->rmsd = sqrt(rmsd/size);
-}
-
-
-//average has enough samples to work with?
-bool average_has_enough_data(average_data_t *avg){
-        return avg->data_count>=average_n;
-}
-
-
-//update averages with new sample
-void update_average(average_data_t *avg, int value){
-
-        avg->last_value = value;
-        avg->buffer[avg->circular_index] = value;
-        avg->data_count++;
-        avg->circular_index++;
-        avg->min_value = min(avg->min_value, value);
-        avg->max_value = max(avg->max_value, value);
-
-        if(avg->data_count>=average_n){
-                int median[AVERAGER_SIZE];
-                int median_idx = 0;
-                if(avg->circular_index>=average_n){
-                        for(int i=avg->circular_index-average_n;i<avg->circular_index;i++){
-                                median[median_idx++]=avg->buffer[i];
-                        }
-                }else{
-                        for(int i=AVERAGER_SIZE-(average_n-avg->circular_index);i<AVERAGER_SIZE;i++){
-                                median[median_idx++]=avg->buffer[i];
-                        }
-                        for(int i=0;i<avg->circular_index;i++){
-                                median[median_idx++]=avg->buffer[i];
-                        }
-               }
-               assert(median_idx==average_n);
-               update_average_from_array(avg, median, average_n);
-
-               qsort(median, average_n, sizeof(int), cmp_int);
-               avg->median = median[average_n/2];
-               avg->min_value_filtered = min(avg->min_value_filtered, avg->median);
-               avg->max_value_filtered = max(avg->max_value_filtered, avg->median);
-
-        }
-
-        if(avg->circular_index>=AVERAGER_SIZE){
-                avg->circular_index = 0;
-        }
-}
-
-#define MAX_SBUS_PACKET_SIZE 128
-
-//probe(logic input) data and timing
-typedef struct probe_data{
-        int time;
-        int last_value;
-
-        int rising_edge_time;
-        int falling_edge_time;
-        int pulse_count;
-
-        bool is_sbus_mode;
-        int is_sbus_active;
-        int sbus_start_time;
-        int sbus_bit_counter;
-        int start_bit_count;
-        int sbus_errors;
-        int sbus_bytes;
-        uint16_t sbus_bits;
-        int parity;
-        int parity_errors;
-        int stop_bits;
-        int sbus_last_byte_time;
-        int sbus_byte_counter;
-        uint8_t sbus_packet[MAX_SBUS_PACKET_SIZE];
-
-        int sbus_byte_counter_last;
-        uint8_t sbus_packet_last[MAX_SBUS_PACKET_SIZE];
-
-        average_data_t pulse_width_avg;
-        average_data_t period_avg;
-
-} probe_data_t;
-
 bool probe_has_enough_data(probe_data_t *probe){
         return probe->pulse_count>=average_n;
 }
 
-//working context, all inputs/probes data
-typedef struct context{
-        int probes_n;
-        probe_data_t probes[MAX_PROBES];
-        int bit_interval;
-        int max_time;
-        int line_num;
-} context_t;
-
-
-
 //convert char to hex digit
 int from_hex(char digit){
         if(digit>='0' && digit<='9'){
@@ -199,85 +52,62 @@ int from_hex(char digit){
 }
 
 
-void feed_bit(context_t *ctx, int probe_idx, probe_data_t *data, int value){
+//record anomaly of enabled trigger kind as event, history takes events of block in time order
+static inline void note_anomaly(context_t *ctx, int probe_idx, probe_data_t *data, int trigger, int64_t time){
+        if(ctx->triggers & trigger){
+                dump_event_t *event = event_buffer_add(data->events, EVENT_TRIGGER, probe_idx, time);
+                if(event!=NULL){
+                        event->trigger.reason = trigger;
+                }
+        }
+}
+
 
-         if(data->last_value!=0 && value==0){
+//process pwm edge on probe, time is sample index of new level
+void feed_edge(context_t *ctx, int probe_idx, probe_data_t *data, int64_t time, int value){
+         data->time = time;
+         if(value==0){
                  //falling edge
                  if(data->rising_edge_time>=0){
-                         update_average(&data->pulse_width_avg, data->time - data->rising_edge_time);
+                         int width = time_delta(time, data->rising_edge_time);
+                         update_average(&data->pulse_width_avg, width);
+                         histogram_add(&data->width_hist, width);
+                         if(width<ctx->width_min || width>ctx->width_max){
+                                 note_anomaly(ctx, probe_idx, data, TRIGGER_WIDTH, data->rising_edge_time);
+                         }
                  }
-                 data->falling_edge_time = data->time;
-         }
-         if(data->last_value==0 && value!=0){
+                 data->falling_edge_time = time;
+         } else {
                  //rising edge
                  if(data->rising_edge_time>=0){
-                         update_average(&data->period_avg, data->time - data->rising_edge_time);
+                         int period = time_delta(time, data->rising_edge_time);
+                         if(data->pulse_count>0){
+                                 //cycle-to-cycle period jitter
+                                 histogram_add(&data->jitter_hist, abs(period - data->period_avg.last_value));
+                         }
+                         update_average(&data->period_avg, period);
+                         histogram_add(&data->period_hist, period);
                          data->pulse_count++;
                  }
-                 data->rising_edge_time = data->time;
-                 if((dump_file!=NULL) && probe_has_enough_data(data)){
-                         fprintf(dump_file, "%d,%d,%d,%d,%d,%d,%d,%f,%f,%f,%f\n",
-                                 probe_idx, ctx->line_num, data->time,
-                                 data->pulse_width_avg.last_value, data->period_avg.last_value,
-                                 data->pulse_width_avg.median, data->period_avg.median,
-                                 data->pulse_width_avg.average, data->period_avg.average,
-                                 data->pulse_width_avg.rmsd, data->period_avg.rmsd);
+                 data->rising_edge_time = time;
+                 if(dump_enabled && probe_has_enough_data(data)){
+                         dump_event_t *event = event_buffer_add(data->events, EVENT_PULSE, probe_idx, time);
+                         if(event!=NULL){
+                                 event->pulse.width = data->pulse_width_avg.last_value;
+                                 event->pulse.period = data->period_avg.last_value;
+                                 event->pulse.width_median = data->pulse_width_avg.median;
+                                 event->pulse.period_median = data->period_avg.median;
+                                 event->pulse.width_average = data->pulse_width_avg.average;
+                                 event->pulse.period_average = data->period_avg.average;
+                                 event->pulse.width_rmsd = data->pulse_width_avg.rmsd;
+                                 event->pulse.period_rmsd = data->period_avg.rmsd;
+                         }
                  }
          }
-
          data->last_value = value;
-         data->time++;
-
-}
-
-
-void decode_sbus_packet(FILE *f, uint8_t *packet, size_t len){        
-    if(len!=25 || packet[0]!=0xF0){
-        fprintf(f, "not SBus packet\n");
-        return;
-    }
-    (void)len;
-    uint16_t current = 0;
-    int bits = 0;
-    int channel = 0;
-    for(int i=1;i<23;i++){
-        uint8_t b = packet[i];
-        for(int j=0;j<8;j++){
-            fprintf(f, "%d", b&1);             
-            bits++;
-            current >>= 1;
-            current |= (b&1)?0x0400:0;
-            b >>= 1;
-            if(bits==11) {
-                    fprintf(f, " [%4d] ", current);
-                    bits = 0;
-                    current = 0;
-                    channel++;
-                    if(channel==8){ 
-                            fprintf(f,"\n");
-                    }
-            }
-            
-            /*if(b&1){
-                current |= 0x400;
-                //current |= 1;
-            }
-            b >>= 1;
-            current >>= 1;
-            //current <<= 1;
-            bits++;
-            if(bits==11) {
-                fprintf(f, "%4.4x ", current);
-                bits = 0;
-                current = 0;
-            }*/
-        }
-    }
-    fprintf(f, "\n");
-    uint8_t b = packet[23];
-    fprintf(f, "d17:%d d18:%d loss:%d f/s:%d\n", (b & 0x80)>>7, (b & 0x40)>>6, (b & 0x20)>>5, (b & 0x10)>>4);
 }
 
+
 void check_sbus_byte(context_t *ctx, int probe_idx, probe_data_t *data){
         (void) ctx;                    
         if((dump_file!=NULL)){
@@ -285,21 +115,35 @@ void check_sbus_byte(context_t *ctx, int probe_idx, probe_data_t *data){
         }
         if(data->parity!=1){
             data->parity_errors++;
+            note_anomaly(ctx, probe_idx, data, TRIGGER_PARITY, data->time);
         }else{
-            if( (data->time - data->sbus_last_byte_time) > 22*ctx->bit_interval) {
+            if( (int64_t)(data->time - data->sbus_last_byte_time)*BIT_INTERVAL_ONE > 22*(int64_t)ctx->bit_interval_fp) {
                 data->sbus_byte_counter_last = data->sbus_byte_counter;
-                memcpy(data->sbus_packet_last, data->sbus_packet, sizeof(data->sbus_packet));
-                if((dump_file!=NULL)){
-                        fprintf(dump_file, "t:%8.8x p:%d data:", data->time, probe_idx);
-                        for(int i=0;i<data->sbus_byte_counter;i++){
-                                fprintf(dump_file, "%2.2x ", data->sbus_packet[i]);
+                if(data->sbus_byte_counter>0){
+                        sbus_stats_t *stats = &data->sbus_stats;
+                        int bad = stats->bad_frames, lost = stats->lost_frames, failsafe = stats->failsafe_frames;
+                        data->sbus_frames++;
+                        sbus_stats_update(stats, data->sbus_packet, data->sbus_byte_counter, data->sbus_packet_time);
+                        if(stats->bad_frames!=bad){
+                                note_anomaly(ctx, probe_idx, data, TRIGGER_FRAME, data->sbus_packet_time);
                         }
-                        fprintf(dump_file, "\n");
-                        decode_sbus_packet(dump_file, data->sbus_packet, data->sbus_byte_counter);
+                        if(stats->lost_frames!=lost){
+                                note_anomaly(ctx, probe_idx, data, TRIGGER_LOST, data->sbus_packet_time);
+                        }
+                        if(stats->failsafe_frames!=failsafe){
+                                note_anomaly(ctx, probe_idx, data, TRIGGER_FAILSAFE, data->sbus_packet_time);
+                        }
+                }
+                memcpy(data->sbus_packet_last, data->sbus_packet, sizeof(data->sbus_packet));
+                if(dump_enabled){
+                        event_buffer_add_packet(data->events, probe_idx, data->time, data->sbus_packet, data->sbus_byte_counter);
                 }
                 
                 data->sbus_byte_counter = 0;
             }
+            if(data->sbus_byte_counter==0){
+                    data->sbus_packet_time = data->time;
+            }
             if(data->sbus_byte_counter<MAX_SBUS_PACKET_SIZE){
                     data->sbus_packet[data->sbus_byte_counter] = data->sbus_bits & 0xFF;
                     if(debug_bitstream){
@@ -318,83 +162,377 @@ void check_sbus_byte(context_t *ctx, int probe_idx, probe_data_t *data){
         }
 }
 
-void process_sbus_bit(context_t *ctx, int probe_idx, probe_data_t *data, int value){
-        int shift = data->time - data->sbus_start_time;
-        if(shift<ctx->bit_interval) {
-            if(value){
-                data->start_bit_count++;
-            }
-            return;
+//sample one data/parity/stop bit of sbus byte
+static void process_sbus_bit(context_t *ctx, int probe_idx, probe_data_t *data, int bit_value){
+        if(debug_bitstream){
+                printf("%d", bit_value);
         }
-        //printf("%d count start %d\n", probe_idx, data->start_bit_count);
-        if(data->start_bit_count < ctx->bit_interval/2){
-            data->is_sbus_active = 0;
-            data->sbus_errors++;
-            return;
+
+        if(data->sbus_bit_counter<8){
+                data->sbus_bits >>= 1;
+                data->sbus_bits |= bit_value?0x80:0x00;
+        }
+        if (data->sbus_bit_counter<9) {
+                data->parity ^= bit_value;
         }
 
-        if (((shift + ctx->bit_interval/2) % ctx->bit_interval) == 0) {
-            //sample bit
-            //printf("sample at %8.8x\n", data->time);
-            int bit_value = value?1:0;
-            if(debug_bitstream){
-                    printf("%d", bit_value);
-            }
+        if( (data->sbus_bit_counter>=9) && !bit_value){
+                data->stop_bits++;
+        }
 
-            if(data->sbus_bit_counter<8){
-                    data->sbus_bits >>= 1;
-                    data->sbus_bits |= bit_value?0x80:0x00;
-            }
-            if (data->sbus_bit_counter<9) {
-                    data->parity ^= bit_value;
-            }
+        data->sbus_bit_counter++;
+        if(data->sbus_bit_counter>=SBUS_BYTE_SAMPLES){
+                if(debug_bitstream){
+                        printf(" ");
+                }
+                check_sbus_byte(ctx, probe_idx, data);
+                data->is_sbus_active = 0;
+                data->sbus_busy_time = data->time;
+        }
+}
 
-            if( (data->sbus_bit_counter>=9) && !bit_value){
-                    data->stop_bits++;
-            }
 
-            data->sbus_bit_counter++;           
-            if(data->sbus_bit_counter>=11){                
-                    if(debug_bitstream){
-                        printf(" ");
-                    }
-                    check_sbus_byte(ctx, probe_idx, data);
-                    data->is_sbus_active = 0;               
-            }
+//run sbus byte decoder up to (not including) time 'until', line level is data->last_value since last edge
+//start bit is checked at ctx->sbus_check_shift, bits are sampled at ctx->sbus_sample_shift[] after start edge
+static void sbus_advance(context_t *ctx, int probe_idx, probe_data_t *data, int64_t until){
+        if(!data->sbus_start_checked){
+                int64_t check_time = data->sbus_start_time + ctx->sbus_check_shift;
+                if(check_time>=until){
+                        return;
+                }
+                if(data->last_value){
+                        data->start_bit_count += check_time - data->sbus_count_from;
+                }
+                data->sbus_start_checked = true;
+                if(data->start_bit_count < ctx->sbus_start_min){
+                        data->is_sbus_active = 0;
+                        data->sbus_busy_time = check_time;
+                        data->sbus_errors++;
+                        note_anomaly(ctx, probe_idx, data, TRIGGER_PARITY, data->sbus_start_time);
+                        return;
+                }
+        }
+        while(data->is_sbus_active){
+                int64_t sample_time = data->sbus_start_time + ctx->sbus_sample_shift[data->sbus_bit_counter];
+                if(sample_time>=until){
+                        return;
+                }
+                data->time = sample_time;
+                process_sbus_bit(ctx, probe_idx, data, data->last_value ? 1 : 0);
         }
+}
+
 
+//process sbus edge on probe, bytes are reconstructed from edge times
+void feed_edge_sbus(context_t *ctx, int probe_idx, probe_data_t *data, int64_t time, int value){
+        if(data->is_sbus_active){
+                //bits before this edge have previous level
+                sbus_advance(ctx, probe_idx, data, time);
+        }
+        if(data->is_sbus_active){
+                if(!data->sbus_start_checked){
+                        //edge inside start bit, count high part
+                        if(data->last_value){
+                                data->start_bit_count += time - data->sbus_count_from;
+                        }
+                        data->sbus_count_from = time;
+                }
+        } else if(value && time>data->sbus_busy_time){
+                //rising edge
+                data->is_sbus_active = 1;//start sbus decode
+                data->sbus_start_time = time;
+                data->sbus_start_checked = false;
+                //start edge sample itself is not counted
+                data->sbus_count_from = time+1;
+                data->sbus_bits = 0;
+                data->sbus_bit_counter = 0;
+                data->start_bit_count = 0;
+                data->parity = 0;
+                data->stop_bits = 0;
+                if(debug_bitstream){
+                        if( (int64_t)(time - data->sbus_last_byte_time)*BIT_INTERVAL_ONE > 22*(int64_t)ctx->bit_interval_fp) {
+                                printf("\x1B[1;1H");
+                        }
+                }
+        }
+        data->last_value = value;
+        data->time = time;
 }
 
 
-void feed_bit_sbus(context_t *ctx, int probe_idx, probe_data_t *data, int value){
-        if(data->is_sbus_active) {
-                //printf("%d sbus_bit %d\n", probe_idx, value);
-                process_sbus_bit(ctx, probe_idx, data, value);
-        } else {
-                if(data->last_value==0 && value!=0){
-                        //printf("%d rise at %8.8x\n", probe_idx, data->time);
-                        //rising edge
-                        data->is_sbus_active = 1;//start sbus decode
-                        data->sbus_start_time = data->time;
-                        data->sbus_bits = 0;
-                        data->sbus_bit_counter = 0;
-                        data->start_bit_count = 0;
-                        data->parity = 0;
-                        data->stop_bits = 0;
-                        if(debug_bitstream){
-                                if( (data->time - data->sbus_last_byte_time) > 22*ctx->bit_interval) {
-                                        printf("\x1B[1;1H");
+//process dshot edge on probe, bits are told apart by high time
+//frame ends after 16 bits, too long pulse or bit start out of bit timing drops partial frame
+void feed_edge_dshot(context_t *ctx, int probe_idx, probe_data_t *data, int64_t time, int value){
+        if(value){
+                //rising edge, start of bit
+                if(data->dshot_bit_counter>0){
+                        int period = time_delta(time, data->dshot_rise_time);
+                        if(period<data->dshot_period_min || period>data->dshot_gap_max){
+                                data->dshot_stats.bit_errors++;
+                                note_anomaly(ctx, probe_idx, data, TRIGGER_DSHOT, data->dshot_frame_time);
+                                data->dshot_bit_counter = 0;
+                        }
+                }
+                if(data->dshot_bit_counter==0){
+                        data->dshot_frame_time = time;
+                        data->dshot_bits = 0;
+                }
+                data->dshot_rise_time = time;
+        } else if(data->dshot_rise_time>=0){
+                //falling edge, end of bit high part
+                int width = time_delta(time, data->dshot_rise_time);
+                if(width>data->dshot_high_max){
+                        //not dshot bit, e.g. pwm pulse
+                        data->dshot_stats.bit_errors++;
+                        note_anomaly(ctx, probe_idx, data, TRIGGER_DSHOT, data->dshot_rise_time);
+                        data->dshot_bit_counter = 0;
+                        data->dshot_rise_time = -1;
+                } else {
+                        data->dshot_bits = (data->dshot_bits<<1) | (width>=data->dshot_one_min);
+                        data->dshot_bit_counter++;
+                        if(data->dshot_bit_counter>=DSHOT_FRAME_BITS){
+                                int crc_errors = data->dshot_stats.crc_errors;
+                                dshot_stats_update(&data->dshot_stats, data->dshot_bits, data->dshot_frame_time);
+                                if(data->dshot_stats.crc_errors!=crc_errors){
+                                        note_anomaly(ctx, probe_idx, data, TRIGGER_DSHOT, data->dshot_frame_time);
+                                }
+                                if(dump_enabled){
+                                        dump_event_t *event = event_buffer_add(data->events, EVENT_DSHOT_FRAME, probe_idx, data->dshot_frame_time);
+                                        if(event!=NULL){
+                                                event->dshot.bits = data->dshot_bits;
+                                        }
                                 }
+                                data->dshot_bit_counter = 0;
                         }
                 }
         }
         data->last_value = value;
-        data->time++;
+        data->time = time;
+}
+
+
+//dshot bit thresholds of probe for bit length
+void init_dshot_timing(probe_data_t *data, int64_t bit_fp){
+        //'0' is high for 3/8 of bit, '1' for 3/4, threshold in the middle
+        data->dshot_one_min = (bit_fp*9/16 + BIT_INTERVAL_ONE-1) / BIT_INTERVAL_ONE;
+        data->dshot_high_max = (bit_fp + BIT_INTERVAL_ONE-1) / BIT_INTERVAL_ONE;
+        //bit starts follow at bit period inside of frame
+        data->dshot_period_min = bit_fp*3/4 / BIT_INTERVAL_ONE;
+        data->dshot_gap_max = (bit_fp*3/2 + BIT_INTERVAL_ONE-1) / BIT_INTERVAL_ONE;
+}
+
+
+//sbus sampling points for bit interval, in samples after start edge
+void init_sbus_timing(context_t *ctx, int bit_interval_fp){
+        ctx->bit_interval_fp = bit_interval_fp;
+        //start bit is checked at first sample after one bit interval
+        ctx->sbus_check_shift = (bit_interval_fp + BIT_INTERVAL_ONE-1) / BIT_INTERVAL_ONE;
+        ctx->sbus_start_min = bit_interval_fp / (2*BIT_INTERVAL_ONE);
+        //bits are sampled at middle of bit interval (rounded up), first one after the start check
+        int k = 1;
+        for(int i=0;i<SBUS_BYTE_SAMPLES;k++){
+                int64_t shift = ((int64_t)k*bit_interval_fp - bit_interval_fp/2 + BIT_INTERVAL_ONE-1) / BIT_INTERVAL_ONE;
+                if(shift>=ctx->sbus_check_shift){
+                        ctx->sbus_sample_shift[i++] = shift;
+                }
+        }
+}
+
+
+//attach decoder to probes in mask
+void init_decoder(decoder_t *dec, context_t *ctx, uint32_t probe_mask){
+        dec->probe_mask = probe_mask;
+        dec->edges_n = 0;
+        dec->history = NULL;
+        init_edge_detector(&dec->detector, probe_mask);
+        memset(&dec->events, 0, sizeof(event_buffer_t));
+        for(int i=0;i<ctx->probes_n;i++){
+                if(probe_mask & (1U<<i)){
+                        ctx->probes[i].events = &dec->events;
+                }
+        }
+}
+
+
+void free_decoder(decoder_t *dec){
+        event_buffer_free(&dec->events);
+}
+
+
+//feed edge to decoder of probe protocol
+static inline __attribute__((always_inline)) void feed_edge_protocol(context_t *ctx, const edge_t *edge, int protocol){
+        probe_data_t *data = &ctx->probes[edge->probe];
+        switch(protocol){
+        case PROTOCOL_SBUS:
+                feed_edge_sbus(ctx, edge->probe, data, edge->time, edge->value);
+                break;
+        case PROTOCOL_DSHOT:
+                feed_edge_dshot(ctx, edge->probe, data, edge->time, edge->value);
+                break;
+        default:
+                feed_edge(ctx, edge->probe, data, edge->time, edge->value);
+                break;
+        }
+}
+
+
+//decode edges of decoder probes, in time order
+//loop is specialized for single protocol, mixed probes dispatch on protocol of every edge
+void decode_edges(context_t *ctx, const edge_t *edges, int n){
+        switch(ctx->protocol){
+        case PROTOCOL_PWM:
+                for(int e=0;e<n;e++){
+                        feed_edge_protocol(ctx, &edges[e], PROTOCOL_PWM);
+                }
+                break;
+        case PROTOCOL_SBUS:
+                for(int e=0;e<n;e++){
+                        feed_edge_protocol(ctx, &edges[e], PROTOCOL_SBUS);
+                }
+                break;
+        case PROTOCOL_DSHOT:
+                for(int e=0;e<n;e++){
+                        feed_edge_protocol(ctx, &edges[e], PROTOCOL_DSHOT);
+                }
+                break;
+        default:
+                for(int e=0;e<n;e++){
+                        feed_edge_protocol(ctx, &edges[e], ctx->probes[edges[e].probe].protocol);
+                }
+                break;
+        }
+}
+
+
+//levels of decoder probes are known up to end_time
+void decode_end(context_t *ctx, decoder_t *dec, int64_t end_time){
+        uint32_t probes = dec->probe_mask;
+        while(probes){
+                int probe_idx = __builtin_ctz(probes);
+                probe_data_t *data = &ctx->probes[probe_idx];
+                if(data->protocol==PROTOCOL_SBUS && data->is_sbus_active){
+                        sbus_advance(ctx, probe_idx, data, end_time);
+                }
+                data->time = end_time;
+                probes &= probes-1;
+        }
+}
+
+
+//decode block of samples (ctx->unitsize bytes each) on decoder probes, block[0] has time base_time
+void decode_block(context_t *ctx, decoder_t *dec, const uint8_t *block, size_t samples, int64_t base_time){
+        //decode only transitions
+        size_t pos = 0;
+        while(pos<samples){
+                int n = extract_edges(&dec->detector, ctx->unitsize, block, samples, &pos, base_time, dec->edges, EDGE_BUFFER_SIZE);
+                dec->edges_n += n;
+                if(edge_index!=NULL){
+                        edge_index_add(edge_index, dec->edges, n);
+                }
+                if(dec->history!=NULL){
+                        history_add(dec->history, dec->edges, n);
+                }
+                decode_edges(ctx, dec->edges, n);
+        }
+        decode_end(ctx, dec, base_time+samples);
+}
+
+
+//parse probe list like "0,1,4-7" into bit mask, returns 0 on success
+int parse_probe_list(const char *list, uint32_t *mask){
+        *mask = 0;
+        const char *p = list;
+        while(*p){
+                char *end;
+                long first = strtol(p, &end, 10);
+                long last = first;
+                if(end==p){
+                        return 1;
+                }
+                p = end;
+                if(*p=='-'){
+                        p++;
+                        last = strtol(p, &end, 10);
+                        if(end==p){
+                                return 1;
+                        }
+                        p = end;
+                }
+                if(first<0 || last>=MAX_PROBES || first>last){
+                        return 1;
+                }
+                for(long i=first;i<=last;i++){
+                        *mask |= 1U<<i;
+                }
+                if(*p==','){
+                        p++;
+                } else if(*p){
+                        return 1;
+                }
+        }
+        return *mask==0;
+}
+
+
+static bool dshot_rate_valid(int rate){
+        return rate==150 || rate==300 || rate==600 || rate==1200;
+}
+
 
+//parse per-probe protocols like "0:sbus,1-5:pwm,6:off,7:dshot600", probes of entry as in probe list
+//sets protocol and dshot rate of listed probes and mask of them, returns 0 on success
+int parse_protocol_list(const char *list, uint8_t *protocols, int *dshot_rates, uint32_t *listed){
+        char buf[1024];
+        if(snprintf(buf, sizeof(buf), "%s", list)>=(int)sizeof(buf)){
+                return 1;
+        }
+        *listed = 0;
+        char *probes = buf;
+        while(*probes){
+                char *colon = strchr(probes, ':');
+                if(colon==NULL){
+                        return 1;
+                }
+                *colon = 0;
+                char *name = colon+1;
+                char *next = strchr(name, ',');
+                if(next!=NULL){
+                        *next++ = 0;
+                } else {
+                        next = name+strlen(name);
+                }
+                uint32_t mask;
+                if(parse_probe_list(probes, &mask)){
+                        return 1;
+                }
+                int protocol;
+                int rate = 0;
+                if(strcmp(name, "pwm")==0){
+                        protocol = PROTOCOL_PWM;
+                } else if(strcmp(name, "sbus")==0){
+                        protocol = PROTOCOL_SBUS;
+                } else if(strcmp(name, "off")==0){
+                        protocol = PROTOCOL_OFF;
+                } else if(strncmp(name, "dshot", 5)==0 && dshot_rate_valid(atoi(name+5))){
+                        protocol = PROTOCOL_DSHOT;
+                        rate = atoi(name+5);
+                } else {
+                        return 1;
+                }
+                for(int i=0;i<MAX_PROBES;i++){
+                        if(mask & (1U<<i)){
+                                protocols[i] = protocol;
+                                dshot_rates[i] = rate;
+                        }
+                }
+                *listed |= mask;
+                probes = next;
+        }
+        return *listed==0;
 }
 
 
-int init_probes(context_t *ctx, int probe_idx, bool sbus_mode){
+int init_probes(context_t *ctx, int probe_idx){
         if(probe_idx<0 || probe_idx>=MAX_PROBES){
                 return 1;
         }
@@ -406,7 +544,7 @@ int init_probes(context_t *ctx, int probe_idx, bool sbus_mode){
                 probe->rising_edge_time = -1;
                 probe->falling_edge_time = -1;
                 probe->pulse_count = 0;
-                probe->is_sbus_mode = sbus_mode;
+                probe->protocol = ctx->protocols[ctx->probes_n];
                 probe->is_sbus_active = 0;
                 probe->sbus_bit_counter = 0;
                 probe->sbus_start_time = 0;
@@ -417,16 +555,65 @@ int init_probes(context_t *ctx, int probe_idx, bool sbus_mode){
                 probe->parity_errors = 0;
                 probe->stop_bits = 0;
                 probe->sbus_last_byte_time = 0;
+                probe->sbus_busy_time = -1;
+                probe->sbus_start_checked = false;
+                probe->sbus_count_from = 0;
                 probe->sbus_byte_counter = 0;
                 probe->sbus_byte_counter_last = 0;
-
-                init_average(&probe->period_avg);
-                init_average(&probe->pulse_width_avg);
+                probe->sbus_packet_time = 0;
+                probe->sbus_frames = 0;
+                init_dshot_timing(probe, ctx->dshot_bit_fp[ctx->probes_n]);
+                probe->dshot_rise_time = -1;
+                probe->dshot_frame_time = 0;
+                probe->dshot_bit_counter = 0;
+                probe->dshot_bits = 0;
+                probe->events = NULL;
+
+                if(init_average(&probe->period_avg, average_n) || init_average(&probe->pulse_width_avg, average_n) ||
+                   init_sbus_stats(&probe->sbus_stats, average_n) || init_dshot_stats(&probe->dshot_stats, average_n)){
+                        fprintf(stderr, "error allocate averaging window %d\n", average_n);
+                        return 1;
+                }
+                if(init_histogram(&probe->width_hist) || init_histogram(&probe->period_hist) || init_histogram(&probe->jitter_hist)){
+                        fprintf(stderr, "error allocate histograms\n");
+                        return 1;
+                }
                 ctx->probes_n++;
         }
         return 0;
 }
 
+//release probes data
+void free_probes(context_t *ctx){
+        for(int i=0;i<ctx->probes_n;i++){
+                free_average(&ctx->probes[i].period_avg);
+                free_average(&ctx->probes[i].pulse_width_avg);
+                free_sbus_stats(&ctx->probes[i].sbus_stats);
+                free_dshot_stats(&ctx->probes[i].dshot_stats);
+                free_histogram(&ctx->probes[i].width_hist);
+                free_histogram(&ctx->probes[i].period_hist);
+                free_histogram(&ctx->probes[i].jitter_hist);
+        }
+        ctx->probes_n = 0;
+}
+
+//write decoded events of output stage to text dump, binary event log and value store, pass anomalies to history
+void output_events(event_buffer_t **buffers, int buffers_n){
+        //buffers are sorted, so values of every probe come in time order
+        write_dump_events(dump_file, event_log, buffers, buffers_n);
+        if(value_store!=NULL){
+                for(int i=0;i<buffers_n;i++){
+                        for(int e=0;e<buffers[i]->count;e++){
+                                value_store_add_event(value_store, buffers[i], &buffers[i]->events[e]);
+                        }
+                }
+        }
+        if(history!=NULL){
+                history_add_events(history, buffers, buffers_n);
+        }
+}
+
+
 //calc timespec diff in ms
 int diffts(struct timespec start, struct timespec end)
 {
@@ -434,6 +621,13 @@ int diffts(struct timespec start, struct timespec end)
            (end.tv_nsec-start.tv_nsec)/1000000;
 }
 
+//calc timespec diff in seconds
+double diffts_sec(struct timespec start, struct timespec end)
+{
+    return (end.tv_sec-start.tv_sec) +
+           (end.tv_nsec-start.tv_nsec)/1e9;
+}
+
 
 //dump averaging result
 void dump_average(char *name, average_data_t *avg, int samplerate){
@@ -454,6 +648,42 @@ void dump_average(char *name, average_data_t *avg, int samplerate){
         printf("\n");
 }
 
+//dump percentiles over whole capture
+void dump_histogram(char *name, histogram_t *h, int samplerate){
+        printf("%s", name);
+        if(h->total==0){
+                printf("no data\n");
+                return;
+        }
+        double koeff = samplerate>0 ? 1000.0/samplerate : 1;
+        printf("n:%llu p50:%f p99:%f p99.9:%f min:%f max:%f%s\n", (unsigned long long)h->total,
+               histogram_percentile(h, 50)*koeff, histogram_percentile(h, 99)*koeff, histogram_percentile(h, 99.9)*koeff,
+               h->min_value*koeff, h->max_value*koeff, samplerate>0 ? " us" : "");
+}
+
+
+//write histograms of all probes as csv
+int export_histograms(context_t *ctx, const char *path){
+        FILE *f = fopen(path, "w");
+        if(f==NULL){
+                fprintf(stderr, "error open %s %s\n", path, strerror(errno));
+                return 1;
+        }
+        fprintf(f, "probe,histogram,low,high,count\n");
+        for(int i=0;i<ctx->probes_n;i++){
+                probe_data_t *probe = &ctx->probes[i];
+                histogram_export(f, &probe->width_hist, i, "width");
+                histogram_export(f, &probe->period_hist, i, "period");
+                histogram_export(f, &probe->jitter_hist, i, "jitter");
+        }
+        if(fclose(f)!=0){
+                fprintf(stderr, "error write %s %s\n", path, strerror(errno));
+                return 1;
+        }
+        return 0;
+}
+
+
 //dump brief data averaging result
 void dump_average_brief(average_data_t *avg, int samplerate){
         if(samplerate>0) {
@@ -469,29 +699,39 @@ void dump_average_brief(average_data_t *avg, int samplerate){
 void dump_result(context_t *ctx, int samplerate, bool brief){
         for(int i=0;i<ctx->probes_n;i++){
                 probe_data_t *probe = &ctx->probes[i];
+                if(probe->protocol!=PROTOCOL_PWM){
+                        continue;
+                }
                 printf("p: %d ", i);
                 if(!probe_has_enough_data(probe)){
                         printf("no data\n");
                         continue;
                 }
                 if(brief){
-                        printf("c:%d ", probe->pulse_count);
+                        printf("c:%lld ", probe->pulse_count);
                         dump_average_brief(&probe->pulse_width_avg, samplerate);
                         //dump_average_brief(&probe->period_avg, samplerate);
                         continue;
                 }
-                printf("pulses:%d\n", probe->pulse_count);
+                printf("pulses:%lld\n", probe->pulse_count);
                 dump_average("  width:  ", &probe->pulse_width_avg, samplerate);
                 dump_average("  period: ", &probe->period_avg, samplerate);
+                dump_histogram("  width:  ", &probe->width_hist, samplerate);
+                dump_histogram("  period: ", &probe->period_hist, samplerate);
+                dump_histogram("  jitter: ", &probe->jitter_hist, samplerate);
+                printf("\n");
         }
 }
 
 
 //dump probe sbus data
-void dump_result_sbus(context_t *ctx){
+void dump_result_sbus(context_t *ctx, int samplerate){
         for(int i=0;i<ctx->probes_n;i++){
                 probe_data_t *probe = &ctx->probes[i];
-                printf("p:%d errors:%d parity_errors:%d bytes:%d packet:%d\n", i, probe->sbus_errors, probe->parity_errors, probe->sbus_bytes, probe->sbus_byte_counter_last);
+                if(probe->protocol!=PROTOCOL_SBUS){
+                        continue;
+                }
+                printf("p:%d errors:%d parity_errors:%d bytes:%lld packet:%d\n", i, probe->sbus_errors, probe->parity_errors, probe->sbus_bytes, probe->sbus_byte_counter_last);
                 if(probe->sbus_byte_counter_last>0){
                         for(int j=0;j<probe->sbus_byte_counter_last;j++){
                                 printf("%2.2x ", probe->sbus_packet_last[j]);
@@ -499,64 +739,230 @@ void dump_result_sbus(context_t *ctx){
                         printf("\n");                    
                         decode_sbus_packet(stdout, probe->sbus_packet_last, probe->sbus_byte_counter_last);
                 }
+                if(probe->sbus_bytes>0){
+                        dump_sbus_stats(&probe->sbus_stats, samplerate);
+                }
+        }
+}
+
+
+//dump probe dshot data
+void dump_result_dshot(context_t *ctx, int samplerate){
+        for(int i=0;i<ctx->probes_n;i++){
+                if(ctx->probes[i].protocol!=PROTOCOL_DSHOT){
+                        continue;
+                }
+                printf("p:%d ", i);
+                dump_dshot_stats(&ctx->probes[i].dshot_stats, samplerate);
         }
 }
 
 
-//process incoming data
-int process_data_binary(context_t *ctx, int samplerate, bool sbus_mode){
+//dump results of every protocol in use
+void dump_results(context_t *ctx, int samplerate, bool brief){
+        bool used[PROTOCOLS] = {false};
+        for(int i=0;i<ctx->probes_n;i++){
+                if(ctx->probes[i].protocol<PROTOCOLS){
+                        used[ctx->probes[i].protocol] = true;
+                }
+        }
+        if(used[PROTOCOL_PWM]){
+                dump_result(ctx, samplerate, brief);
+        }
+        if(used[PROTOCOL_SBUS]){
+                dump_result_sbus(ctx, samplerate);
+        }
+        if(used[PROTOCOL_DSHOT]){
+                dump_result_dshot(ctx, samplerate);
+        }
+}
+
 
-        struct timespec lts;
-        if(clock_gettime(CLOCK_MONOTONIC, &lts)!=0){
-                fprintf(stderr, "error get clock %s\n", strerror(errno));
+//process incoming data, display may be NULL
+int process_data_binary(context_t *ctx, input_t *in, display_t *display){
+        int unitsize = ctx->unitsize;
+        if(init_probes(ctx, 31-__builtin_clz(ctx->probe_mask))){
                 return 1;
         }
-        init_probes(ctx, 7, sbus_mode);//0-7 probes
-        int i;
-        while((i=fgetc(stdin))!=EOF){
-                //printf("%p %s\n", buffer, buffer);
-                int mask = 1;
-                for(int probe_idx=0;probe_idx<8;probe_idx++){
-                        if(sbus_mode) {
-                                feed_bit_sbus(ctx, probe_idx, &ctx->probes[probe_idx], i & mask);
-                        } else {
-                                feed_bit(ctx, probe_idx, &ctx->probes[probe_idx], i & mask);
-                        }
+        decoder_t *decoder = malloc(sizeof(decoder_t));
+        if(decoder==NULL){
+                fprintf(stderr, "error allocate decoder\n");
+                return 1;
+        }
+        init_decoder(decoder, ctx, ctx->probe_mask);
+        decoder->history = history;
+        event_buffer_t *events = &decoder->events;
+        const uint8_t *block;
+        ssize_t len;
+        int64_t t = monitor_now();
+        while((len=input_next_block(in, &block))>0){
+                int64_t arrival = monitor_stage(monitor, STAGE_READ, t);
+                len /= unitsize;
+                decode_block(ctx, decoder, block, len, ctx->line_num-1);
+                ctx->line_num += len;
+                t = monitor_stage(monitor, STAGE_DECODE, arrival);
+                if(dump_enabled || history!=NULL){
+                        output_events(&events, 1);
+                }
+                event_buffer_clear(events);
+                if(history!=NULL){
+                        history_check(history, ctx->line_num-1);
+                }
 
-                        mask<<=1;
+                //display thread asks for snapshot, checked once per block
+                if(display_wanted(display)){
+                        ctx->edges_n = decoder->edges_n;
+                        display_publish(display, ctx);
+                }
+                if(telemetry!=NULL){
+                        ctx->edges_n = decoder->edges_n;
+                        telemetry_publish(telemetry, ctx);
                 }
+                monitor_stage(monitor, STAGE_OUTPUT, t);
+                monitor_block(monitor, arrival, len, decoder->edges_n, count_frames(ctx->probes, ctx->probes_n));
+                t = monitor_now();
+        }
+        ctx->edges_n = decoder->edges_n;
+        free_decoder(decoder);
+        free(decoder);
+        if(len<0){
+                return 1;
+        }
+        return 0;
+}
 
-                if((ctx->line_num & 0xFFF)==0){
-                        struct timespec ts;
-                        if(clock_gettime(CLOCK_MONOTONIC, &ts)!=0){
-                                fprintf(stderr, "error get clock %s\n", strerror(errno));
-                                return 1;
-                        }
-                        (void)samplerate;
-                        if(!debug_bitstream){
-                                if(diffts(lts, ts)>250){
-                                        printf("\x1B[1;1H");
-                                        printf("%d\n", ctx->line_num);
-                                        if(sbus_mode){
-                                                dump_result_sbus(ctx);
-                                        } else {
-                                                dump_result(ctx, samplerate, true);
-                                        }
-                                        lts=ts;
-                                }
+
+//process edges from index, starting at index reader position, display may be NULL
+int process_data_index(context_t *ctx, edge_index_reader_t *index, display_t *display){
+        if(init_probes(ctx, 31-__builtin_clz(ctx->probe_mask))){
+                return 1;
+        }
+        decoder_t *decoder = malloc(sizeof(decoder_t));
+        if(decoder==NULL){
+                fprintf(stderr, "error allocate decoder\n");
+                return 1;
+        }
+        init_decoder(decoder, ctx, ctx->probe_mask);
+        event_buffer_t *events = &decoder->events;
+        int64_t samples = index->header.samples;
+        int64_t time = index->start_time;
+        while(time<samples){
+                //same block length as sample input, so events are written in similar portions
+                int64_t end_time = time+INPUT_BLOCK_SIZE;
+                if(end_time>samples){
+                        end_time = samples;
+                }
+                //index reading counts as read stage, samples arrive when block is started
+                int64_t arrival = monitor_now();
+                int64_t t = arrival;
+                int n;
+                while((n = edge_index_read(index, end_time, decoder->edges, EDGE_BUFFER_SIZE))>0){
+                        t = monitor_stage(monitor, STAGE_READ, t);
+                        decoder->edges_n += n;
+                        if(history!=NULL){
+                                history_add(history, decoder->edges, n);
                         }
+                        decode_edges(ctx, decoder->edges, n);
+                        t = monitor_stage(monitor, STAGE_DECODE, t);
+                }
+                decode_end(ctx, decoder, end_time);
+                t = monitor_stage(monitor, STAGE_DECODE, t);
+                ctx->line_num += end_time-time;
+                if(dump_enabled || history!=NULL){
+                        output_events(&events, 1);
+                }
+                event_buffer_clear(events);
+                if(history!=NULL){
+                        history_check(history, end_time);
                 }
 
-                ctx->line_num++;
+                if(display_wanted(display)){
+                        ctx->edges_n = decoder->edges_n;
+                        display_publish(display, ctx);
+                }
+                if(telemetry!=NULL){
+                        ctx->edges_n = decoder->edges_n;
+                        telemetry_publish(telemetry, ctx);
+                }
+                monitor_stage(monitor, STAGE_OUTPUT, t);
+                monitor_block(monitor, arrival, end_time-time, decoder->edges_n, count_frames(ctx->probes, ctx->probes_n));
+                time = end_time;
         }
+        ctx->edges_n = decoder->edges_n;
+        free_decoder(decoder);
+        free(decoder);
         return 0;
 }
 
 
+//completed frames of all protocols
+long long count_frames(const probe_data_t *probes, int probes_n){
+        long long frames = 0;
+        for(int i=0;i<probes_n;i++){
+                frames += probes[i].sbus_frames + probes[i].dshot_stats.frames;
+        }
+        return frames;
+}
+
+
+//dump input throughput against nominal samplerate (kHz), decoded edges/frames rate and stage counters
+void dump_throughput(context_t *ctx, int samplerate, double seconds){
+        int64_t samples = ctx->line_num-1-ctx->first_sample;
+        long long frames = count_frames(ctx->probes, ctx->probes_n);
+        printf("samples:%lld time:%.3fs", (long long)samples, seconds);
+        if(seconds>0){
+                printf(" throughput:%.2f MSamples/s", samples/seconds/1e6);
+                if(samplerate>0){
+                        printf(" realtime:%.2fx", samples/seconds/(samplerate*1e3));
+                }
+        }
+        printf("\n");
+        printf("edges:%lld", ctx->edges_n);
+        if(seconds>0){
+                printf(" %.0f edges/s", ctx->edges_n/seconds);
+        }
+        printf(" frames:%lld", frames);
+        if(seconds>0){
+                printf(" %.0f frames/s", frames/seconds);
+        }
+        printf("\n");
+        dump_monitor(monitor);
+}
+
+
 //usage help
 void show_help(){
         printf("pwm (servo) signal analyzer, for using with sigrok logic analyzer software\n");
-        printf(" Usage: pwm [-n buffer_length] [-s sample_rate_khz] [-v debug_level] [--sbus] [-d data_dump_file] [-h] < sigrok_binary_file\n");
+        printf(" Usage: pwm [-n buffer_length] [-s sample_rate_khz] [-v debug_level] [--sbus | -x dshot_rate] [-p probe_protocols] [-d data_dump_file] [-D event_log] [-V value_store] [-H histogram.csv] [-u unitsize] [-c probe_list] [-j threads] [-P threads] [-i file.sr | -A driver [-C config]] [-r refresh_ms] [-W index] [-X index [-t start_s]] [-S stats_ms] [-M shm_name] [-T triggers [-B pre_s[:post_s]] [-O prefix]] [-h] < sigrok_binary_file\n");
+        printf("  -x, --dshot     decode dshot with bit rate 150, 300, 600 or 1200 kbit/s instead of pwm\n");
+        printf("  -p, --protocols protocol per probe: pwm, sbus, dshot150..dshot1200 or off, e.g. 0:sbus,1-5:pwm,6:off\n");
+        printf("                  probes not listed use -b/-x protocol (default pwm), off probes are not scanned\n");
+        printf("  -D, --log       write decoded events to binary log (fast), convert to -d text form with pwmlog\n");
+        printf("  -V, --values    write decoded values (pwm width and period, sbus channels and flags, dshot value) to\n");
+        printf("                  columnar store with per-block time range and min/max, query with pwmquery\n");
+        printf("  -H, --histogram write width, period and cycle-to-cycle jitter histograms of whole capture as csv\n");
+        printf("  -u, --unitsize  bytes per sample: 1 (8 probes), 2 (16 probes) or 4 (32 probes), default from probe list\n");
+        printf("  -i, --input     read sigrok binary or session (.sr) file instead of stdin,\n");
+        printf("                  session file provides samplerate, unitsize and probes\n");
+        printf("                  repeated -i decodes up to %d fifos or files as one capture: path[:samplerate=kHz][:unitsize=n][:offset=us|auto],\n", MERGE_MAX_INPUTS);
+        printf("                  probes are numbered across inputs in -i order, time base is highest samplerate\n");
+        printf("  -A, --acquire   acquire from sigrok device instead of stdin (pwm-sigrok build), driver[:conn=...],\n");
+        printf("                  samplerate and probes are taken from device, e.g. -A demo\n");
+        printf("  -C, --config    device config as sigrok-cli --config, e.g. samplerate=1m:limit_samples=10m\n");
+        printf("  -W, --write-index  write edge index of decoded probes for fast re-analysis\n");
+        printf("  -X, --index     decode edges from index instead of samples, index provides samplerate and probes\n");
+        printf("  -t, --start     with -X, start decoding at time offset in seconds\n");
+        printf("  -j, --threads   decoder threads, with separate reader and output stages (default 0: single thread)\n");
+        printf("  -r, --refresh   live display refresh interval in ms, rendered by separate thread (default 250, 0: off)\n");
+        printf("  -P, --parallel  offline mode for files: scan consecutive blocks on threads, decode edges in order\n");
+        printf("  -S, --stats     print machine readable counters line to stderr every stats_ms: input rate against\n");
+        printf("                  samplerate, edge and frame rates, time per stage, block latency, input underruns\n");
+        printf("  -M, --shm       publish live probe state to POSIX shared memory segment, layout in telemetry.h, see pwmshm\n");
+        printf("  -T, --trigger   keep history of decoded probes and write it as sigrok binary file on anomaly:\n");
+        printf("                  parity, frame, failsafe, lost (sbus), dshot (crc or bit error), width=min-max (pwm, us), all\n");
+        printf("  -B, --history   history before and after trigger in seconds (default 1:0.2)\n");
+        printf("  -O, --trigger-output  history file prefix, files are prefix-N.bin (default trigger)\n");
+        printf("  -c, --channels  decoded probes, same as sigrok-cli -p list, e.g. 0-3,8 (default all probes of unitsize)\n");
         printf(" Usage: sigrok-cli -d fx2lafw --config samplerate=100k --continuous -p 0,1,2,3,4,5 -o /dev/stdout -O binary | ./pwm [-s 100] -d values.csv\n");
 }
 
@@ -566,7 +972,35 @@ int main(int argc, char** argv){
         context_t context;
         int ch;
         int samplerate=0;
-        bool sbus_mode = false;//frsky sbus decoder
+        int threads=0;
+        int refresh_ms=250;
+        bool chunked=false;
+        int unitsize=0;
+        uint32_t probe_mask=0;
+        char *input_path = NULL;
+        char *input_specs[MERGE_MAX_INPUTS];
+        int inputs_n = 0;
+        merge_t *merge = NULL;
+        char *device_spec = NULL;
+        char *device_config = NULL;
+        char *log_path = NULL;
+        char *store_path = NULL;
+        char *histogram_path = NULL;
+        char *index_write_path = NULL;
+        char *index_read_path = NULL;
+        double start_seconds = 0;
+        int stats_ms = 0;
+        char *shm_name = NULL;
+        char *trigger_list = NULL;
+        char *trigger_prefix = "trigger";
+        double history_pre = 1.0;//s
+        double history_post = 0.2;
+        int protocol = PROTOCOL_PWM;
+        int dshot_rate = 0;//kbit/s
+        char *protocol_list = NULL;
+        uint8_t protocols[MAX_PROBES];
+        int dshot_rates[MAX_PROBES];
+        uint32_t protocol_listed = 0;
 
         static struct option longopts[] = {
                 { "help", no_argument, NULL, 'h' },
@@ -574,18 +1008,43 @@ int main(int argc, char** argv){
                 { "length", required_argument, NULL, 'n' },
                 { "samplerate", required_argument, NULL, 's' },
                 { "dump", required_argument, NULL, 'd' },
+                { "log", required_argument, NULL, 'D' },
+                { "values", required_argument, NULL, 'V' },
                 { "sbus", optional_argument, NULL, 'b' },
+                { "dshot", required_argument, NULL, 'x' },
+                { "protocols", required_argument, NULL, 'p' },
+                { "unitsize", required_argument, NULL, 'u' },
+                { "channels", required_argument, NULL, 'c' },
+                { "threads", required_argument, NULL, 'j' },
+                { "parallel", required_argument, NULL, 'P' },
+                { "refresh", required_argument, NULL, 'r' },
+                { "histogram", required_argument, NULL, 'H' },
+                { "write-index", required_argument, NULL, 'W' },
+                { "index", required_argument, NULL, 'X' },
+                { "start", required_argument, NULL, 't' },
+                { "input", required_argument, NULL, 'i' },
+                { "acquire", required_argument, NULL, 'A' },
+                { "config", required_argument, NULL, 'C' },
+                { "stats", required_argument, NULL, 'S' },
+                { "shm", required_argument, NULL, 'M' },
+                { "trigger", required_argument, NULL, 'T' },
+                { "history", required_argument, NULL, 'B' },
+                { "trigger-output", required_argument, NULL, 'O' },
 
                 { NULL, 0, NULL, 0 }
         };
 
-        while ((ch = getopt_long(argc, argv, "hv:n:s:d:b", longopts, NULL)) != -1)
+        while ((ch = getopt_long(argc, argv, "hv:n:s:d:D:V:bx:p:u:c:j:P:i:r:H:W:X:t:S:M:T:B:O:A:C:", longopts, NULL)) != -1)
                 switch (ch) {
                 case 'h':
                     show_help();
                     return 0;
                 case 'n':
                     average_n = atoi(optarg);
+                    if(average_n<1){
+                            fprintf(stderr, "invalid buffer length %s\n", optarg);
+                            return 1;
+                    }
                     break;
                 case 'v':
                     verbose = atoi(optarg);
@@ -596,25 +1055,416 @@ int main(int argc, char** argv){
                 case 'd':
                     dump_file = fopen(optarg, "w");
                     break;
+                case 'D':
+                    log_path = optarg;
+                    break;
+                case 'V':
+                    store_path = optarg;
+                    break;
+                case 'H':
+                    histogram_path = optarg;
+                    break;
+                case 'W':
+                    index_write_path = optarg;
+                    break;
+                case 'X':
+                    index_read_path = optarg;
+                    break;
+                case 't':
+                    start_seconds = atof(optarg);
+                    if(start_seconds<0){
+                            fprintf(stderr, "invalid start time %s\n", optarg);
+                            return 1;
+                    }
+                    break;
                 case 'b':
-                    sbus_mode = true;
+                    protocol = PROTOCOL_SBUS;//frsky sbus decoder
+                    break;
+                case 'x':
+                    dshot_rate = atoi(optarg);
+                    if(!dshot_rate_valid(dshot_rate)){
+                            fprintf(stderr, "invalid dshot rate %s, must be 150, 300, 600 or 1200\n", optarg);
+                            return 1;
+                    }
+                    protocol = PROTOCOL_DSHOT;
+                    break;
+                case 'p':
+                    protocol_list = optarg;
+                    break;
+                case 'u':
+                    unitsize = atoi(optarg);
+                    if(unitsize!=1 && unitsize!=2 && unitsize!=4){
+                            fprintf(stderr, "invalid unitsize %s, must be 1, 2 or 4\n", optarg);
+                            return 1;
+                    }
+                    break;
+                case 'j':
+                    threads = atoi(optarg);
+                    if(threads<0 || threads>MAX_PROBES){
+                            fprintf(stderr, "invalid threads count %s\n", optarg);
+                            return 1;
+                    }
+                    break;
+                case 'P':
+                    threads = atoi(optarg);
+                    if(threads<1 || threads>MAX_PROBES){
+                            fprintf(stderr, "invalid threads count %s\n", optarg);
+                            return 1;
+                    }
+                    chunked = true;
+                    break;
+                case 'i':
+                    if(inputs_n>=MERGE_MAX_INPUTS){
+                            fprintf(stderr, "at most %d inputs are supported\n", MERGE_MAX_INPUTS);
+                            return 1;
+                    }
+                    input_specs[inputs_n++] = optarg;
+                    input_path = input_specs[0];
+                    break;
+                case 'A':
+                    device_spec = optarg;
+                    break;
+                case 'C':
+                    device_config = optarg;
+                    break;
+                case 'M':
+                    shm_name = optarg;
+                    break;
+                case 'T':
+                    trigger_list = optarg;
+                    break;
+                case 'B': {
+                    char *e;
+                    history_pre = strtod(optarg, &e);
+                    if(*e==':'){
+                            history_post = strtod(e+1, &e);
+                    }
+                    if(*e || history_pre<0 || history_post<0){
+                            fprintf(stderr, "invalid history length %s\n", optarg);
+                            return 1;
+                    }
+                    break;
+                }
+                case 'O':
+                    trigger_prefix = optarg;
+                    break;
+                case 'S':
+                    stats_ms = atoi(optarg);
+                    if(stats_ms<=0){
+                            fprintf(stderr, "invalid stats interval %s\n", optarg);
+                            return 1;
+                    }
+                    break;
+                case 'r':
+                    refresh_ms = atoi(optarg);
+                    if(refresh_ms<0){
+                            fprintf(stderr, "invalid refresh interval %s\n", optarg);
+                            return 1;
+                    }
+                    break;
+                case 'c':
+                    if(parse_probe_list(optarg, &probe_mask)){
+                            fprintf(stderr, "invalid probe list %s\n", optarg);
+                            return 1;
+                    }
                     break;
                 default:
                     show_help();
                     return 1;
         }
 
+        //probes not listed in protocol list use global protocol
+        for(int i=0;i<MAX_PROBES;i++){
+                protocols[i] = protocol;
+                dshot_rates[i] = dshot_rate;
+        }
+        if(protocol_list!=NULL && parse_protocol_list(protocol_list, protocols, dshot_rates, &protocol_listed)){
+                fprintf(stderr, "invalid protocol list %s\n", protocol_list);
+                return 1;
+        }
+
+        if(device_spec!=NULL && (input_path!=NULL || index_read_path!=NULL)){
+                fprintf(stderr, "device acquisition (-A) does not take input file\n");
+                return 1;
+        }
+        if(inputs_n>1 && (index_read_path!=NULL || index_write_path!=NULL || threads>0)){
+                fprintf(stderr, "several inputs are decoded by single thread without edge index (-j, -P, -W, -X)\n");
+                return 1;
+        }
+        if(device_config!=NULL && device_spec==NULL){
+                fprintf(stderr, "device config needs device (-A)\n");
+                return 1;
+        }
+
+        if(start_seconds>0 && index_read_path==NULL){
+                fprintf(stderr, "start time needs edge index input (-X)\n");
+                return 1;
+        }
+
+        //open input, session file and edge index provide samplerate and probes
+        input_t input;
+        edge_index_reader_t index;
+        if(index_read_path!=NULL){
+                if(edge_index_open(&index, index_read_path)){
+                        return 1;
+                }
+                if(samplerate==0){
+                        samplerate = index.header.samplerate/1000;
+                }
+                if(unitsize!=0 && unitsize!=(int)index.header.unitsize){
+                        fprintf(stderr, "unitsize %d does not match edge index unitsize %u\n", unitsize, index.header.unitsize);
+                        return 1;
+                }
+                unitsize = index.header.unitsize;
+                if(probe_mask==0){
+                        probe_mask = index.header.probe_mask;
+                }
+                if(probe_mask & ~index.header.probe_mask){
+                        fprintf(stderr, "probe list is not in edge index probes %8.8x\n", index.header.probe_mask);
+                        return 1;
+                }
+        } else if(inputs_n>1){
+                merge = merge_open(input_specs, inputs_n, samplerate, unitsize);
+                if(merge==NULL){
+                        return 1;
+                }
+                samplerate = merge->samplerate;
+                unitsize = merge->unitsize;
+                uint32_t inputs_mask = merge_probe_mask(merge);
+                if(probe_mask==0){
+                        probe_mask = inputs_mask;
+                }
+                if(probe_mask & ~inputs_mask){
+                        fprintf(stderr, "probe list is not in input probes %8.8x\n", inputs_mask);
+                        return 1;
+                }
+        } else if(input_path!=NULL && sr_is_session_file(input_path)){
+                if(input_open_sr(&input, input_path, INPUT_BLOCK_SIZE)){
+                        return 1;
+                }
+                sr_file_t *sr = input.sr;
+                if(samplerate==0){
+                        samplerate = sr->samplerate/1000;
+                }
+                if(unitsize!=0 && unitsize!=sr->unitsize){
+                        fprintf(stderr, "unitsize %d does not match session file unitsize %d\n", unitsize, sr->unitsize);
+                        return 1;
+                }
+                unitsize = sr->unitsize;
+                if(probe_mask==0){
+                        probe_mask = sr->probes_n>=32 ? 0xFFFFFFFF : (1U<<sr->probes_n)-1;
+                }
+                fprintf(stderr, "%s: samplerate %llu Hz, unitsize %d, probes:", input_path, (unsigned long long)sr->samplerate, sr->unitsize);
+                for(int i=0;i<sr->probes_n;i++){
+                        if(sr->probe_names[i][0]){
+                                fprintf(stderr, " %d:%s", i, sr->probe_names[i]);
+                        }
+                }
+                fprintf(stderr, "\n");
+        } else if(device_spec!=NULL){
+                if(input_open_device(&input, device_spec, device_config)){
+                        return 1;
+                }
+                device_t *dev = input.device;
+                if(samplerate==0){
+                        samplerate = dev->samplerate/1000;
+                } else if(dev->samplerate!=0 && (uint64_t)samplerate*1000!=dev->samplerate){
+                        fprintf(stderr, "samplerate %dk does not match device samplerate %llu Hz, set it with -C samplerate=...\n",
+                                samplerate, (unsigned long long)dev->samplerate);
+                        return 1;
+                }
+                if(unitsize!=0 && unitsize!=dev->unitsize){
+                        fprintf(stderr, "unitsize %d does not match device unitsize %d\n", unitsize, dev->unitsize);
+                        return 1;
+                }
+                unitsize = dev->unitsize;
+                if(probe_mask==0){
+                        probe_mask = dev->probes_n>=32 ? 0xFFFFFFFF : (1U<<dev->probes_n)-1;
+                }
+                fprintf(stderr, "%s: samplerate %llu Hz, unitsize %d, probes:", dev->name, (unsigned long long)dev->samplerate, dev->unitsize);
+                for(int i=0;i<dev->probes_n;i++){
+                        if(dev->probe_names[i][0]){
+                                fprintf(stderr, " %d:%s", i, dev->probe_names[i]);
+                        }
+                }
+                fprintf(stderr, "\n");
+        } else {
+                int fd = STDIN_FILENO;
+                if(input_path!=NULL){
+                        fd = open(input_path, O_RDONLY);
+                        if(fd<0){
+                                fprintf(stderr, "error open %s %s\n", input_path, strerror(errno));
+                                return 1;
+                        }
+                }
+                if(input_open_fd(&input, fd, INPUT_BLOCK_SIZE)){
+                        return 1;
+                }
+        }
+
+        //sample width from highest listed probe
+        if(unitsize==0){
+                uint32_t listed = probe_mask ? probe_mask : protocol_listed;
+                int highest = listed ? 31-__builtin_clz(listed) : 0;
+                unitsize = highest<8 ? 1 : highest<16 ? 2 : 4;
+        }
+        uint32_t unit_mask = unitsize==4 ? 0xFFFFFFFF : (1U<<(unitsize*8))-1;
+        if(probe_mask==0){
+                probe_mask = unit_mask;
+        }
+        if(probe_mask & ~unit_mask){
+                fprintf(stderr, "probe list does not fit unitsize %d\n", unitsize);
+                return 1;
+        }
+        if(index_read_path==NULL && merge==NULL){
+                input_set_unitsize(&input, unitsize);
+        }
+
+        //off probes are not scanned at all
+        for(int i=0;i<MAX_PROBES;i++){
+                if(protocols[i]==PROTOCOL_OFF){
+                        probe_mask &= ~(1U<<i);
+                }
+        }
+        if(probe_mask==0){
+                fprintf(stderr, "all probes are off\n");
+                return 1;
+        }
+
         //init context
         context.probes_n = 0;
+        context.unitsize = unitsize;
+        context.probe_mask = probe_mask;
         context.max_time = 0;
         context.line_num = 1;
-        context.bit_interval = samplerate/100;//sbus has 100000 bit per second
-        if(sbus_mode && context.bit_interval<10){
-                fprintf(stderr, "sbus decoder need at least 1000k samplerate\n");
+        context.first_sample = 0;
+        context.edges_n = 0;
+        context.triggers = 0;
+        context.width_min = 0;
+        context.width_max = INT_MAX;
+        context.protocol = protocols[__builtin_ctz(probe_mask)];
+        memcpy(context.protocols, protocols, sizeof(context.protocols));
+        init_sbus_timing(&context, (int64_t)samplerate*BIT_INTERVAL_ONE/SBUS_BAUDRATE_KHZ);
+        for(int i=0;i<MAX_PROBES;i++){
+                context.dshot_bit_fp[i] = dshot_rates[i]>0 ? (int64_t)samplerate*BIT_INTERVAL_ONE/dshot_rates[i] : 0;
+                if(!(probe_mask & (1U<<i))){
+                        continue;
+                }
+                if(protocols[i]!=context.protocol){
+                        context.protocol = PROTOCOL_MIXED;
+                }
+                if(protocols[i]==PROTOCOL_SBUS && samplerate<SBUS_MIN_SAMPLERATE){
+                        fprintf(stderr, "sbus decoder need at least %dk samplerate\n", SBUS_MIN_SAMPLERATE);
+                        return 1;
+                }
+                if(protocols[i]==PROTOCOL_DSHOT && samplerate<dshot_rates[i]*DSHOT_MIN_BIT_SAMPLES){
+                        fprintf(stderr, "dshot%d decoder need at least %dk samplerate\n", dshot_rates[i], dshot_rates[i]*DSHOT_MIN_BIT_SAMPLES);
+                        return 1;
+                }
+        }
+
+        if(log_path!=NULL){
+                event_log = event_log_open(log_path, (uint64_t)samplerate*1000, probe_mask, context.protocol, context.protocols);
+                if(event_log==NULL){
+                        return 1;
+                }
+        }
+        if(store_path!=NULL){
+                value_store = value_store_create(store_path, (uint64_t)samplerate*1000, probe_mask, context.protocols);
+                if(value_store==NULL){
+                        return 1;
+                }
+        }
+        dump_enabled = dump_file!=NULL || event_log!=NULL || value_store!=NULL;
+
+        if(index_write_path!=NULL){
+                edge_index = edge_index_create(index_write_path, probe_mask);
+                if(edge_index==NULL){
+                        return 1;
+                }
+        }
+        if(index_read_path!=NULL){
+                int64_t start_time = (int64_t)(start_seconds*samplerate*1000);
+                if(edge_index_seek(&index, probe_mask, start_time)){
+                        return 1;
+                }
+                context.first_sample = start_time;
+                context.line_num = start_time+1;
+        }
+
+        if(trigger_list!=NULL){
+                int width_min_us = 0, width_max_us = 0;
+                if(parse_trigger_list(trigger_list, &context.triggers, &width_min_us, &width_max_us)){
+                        fprintf(stderr, "invalid trigger list %s\n", trigger_list);
+                        return 1;
+                }
+                if(context.triggers & TRIGGER_WIDTH){
+                        //samplerate is in kHz, so samples per ms
+                        context.width_min = (int64_t)width_min_us*samplerate/1000;
+                        context.width_max = ((int64_t)width_max_us*samplerate+999)/1000;
+                }
+                history = history_open(probe_mask, unitsize, samplerate, history_pre*samplerate*1000, history_post*samplerate*1000,
+                                       trigger_prefix, context.first_sample);
+                if(history==NULL){
+                        return 1;
+                }
+        }
+
+        if(shm_name!=NULL){
+                telemetry = telemetry_open(shm_name, (uint64_t)samplerate*1000, probe_mask);
+                if(telemetry==NULL){
+                        return 1;
+                }
+        }
+
+        display_t *display = NULL;
+        if(refresh_ms>0 && !debug_bitstream){
+                display = display_start(refresh_ms, samplerate);
+                if(display==NULL){
+                        return 1;
+                }
+        }
+
+        //stream input is limited by acquisition, so its rate is checked against samplerate
+        monitor_t monitor_data;
+        bool live = merge!=NULL ? merge->live : index_read_path==NULL && input.sr==NULL && !input_is_mapped(&input);
+        if(monitor_init(&monitor_data, samplerate, live, stats_ms, stderr)){
+                fprintf(stderr, "error allocate counters\n");
+                return 1;
         }
+        monitor = &monitor_data;
 
+        struct timespec start_ts, end_ts;
+        clock_gettime(CLOCK_MONOTONIC, &start_ts);
         int r = 1;
-        r = process_data_binary(&context, samplerate, sbus_mode);
+        if(index_read_path!=NULL){
+                r = process_data_index(&context, &index, display);
+        } else if(merge!=NULL){
+                r = process_data_merged(&context, merge, display);
+        } else if(chunked){
+                r = process_data_chunked(&context, &input, display, threads);
+        } else if(threads>0){
+                r = process_data_threaded(&context, &input, display, threads);
+        } else {
+                r = process_data_binary(&context, &input, display);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end_ts);
+        display_stop(display);
+        if(telemetry!=NULL){
+                telemetry_publish(telemetry, &context);
+                telemetry_close(telemetry);
+        }
+        if(history!=NULL){
+                history_close(history);
+        }
+        if(index_read_path!=NULL){
+                edge_index_close_reader(&index);
+        } else if(merge==NULL){
+                input_close(&input);
+        }
+        if(edge_index!=NULL && edge_index_close(edge_index, context.line_num-1, (uint64_t)samplerate*1000, unitsize)){
+                r = 1;
+        }
         if(r){
                 fprintf(stderr, "error process_data %d\n", r);
                 return 1;
@@ -623,12 +1473,24 @@ int main(int argc, char** argv){
         if(dump_file) {
                 fclose(dump_file);
         }
-        if(sbus_mode){
-                dump_result_sbus(&context);
-        } else {
-                dump_result(&context, samplerate, false);
+        if(event_log!=NULL && event_log_close(event_log)){
+                return 1;
+        }
+        if(value_store!=NULL && value_store_close(value_store)){
+                return 1;
         }
+        dump_results(&context, samplerate, false);
+        dump_throughput(&context, samplerate, diffts_sec(start_ts, end_ts));
+        if(merge!=NULL){
+                dump_merge(merge);
+                merge_close(merge);
+        }
+        if(histogram_path!=NULL && export_histograms(&context, histogram_path)){
+                r = 1;
+        }
+        free_probes(&context);
+        monitor_free(monitor);
 
-        return 0;
+        return r;
 }
 
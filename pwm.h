@@ -0,0 +1,189 @@
+#ifndef PWM_H
+#define PWM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "input.h"
+#include "edges.h"
+#include "average.h"
+#include "eventlog.h"
+#include "sbus.h"
+#include "dshot.h"
+#include "display.h"
+#include "histogram.h"
+#include "edgeindex.h"
+#include "monitor.h"
+#include "telemetry.h"
+#include "history.h"
+#include "merge.h"
+#include "store.h"
+
+#define MAX_PROBES 32
+
+#define MAX_SBUS_PACKET_SIZE 128
+
+//sbus is 100000 bit per second, 8E2 inverted uart
+#define SBUS_BAUDRATE_KHZ 100
+//start bit, 8 data bits, parity and 2 stop bits, start bit is not sampled
+#define SBUS_BYTE_SAMPLES 11
+//at least 4 samples per bit
+#define SBUS_MIN_SAMPLERATE 400
+
+//dshot bit rate is 150, 300, 600 or 1200 kbit per second
+//at least 4 samples per dshot bit, so 3/8 and 3/4 high times differ by more than one sample
+#define DSHOT_MIN_BIT_SAMPLES 4
+
+//fixed point 16.16 unit for fractional bit intervals
+#define BIT_INTERVAL_ONE 65536
+
+//window size for averaging
+extern int average_n;
+
+extern int verbose;
+extern int debug_bitstream;
+extern FILE *dump_file;
+extern event_log_t *event_log;
+//columnar store of decoded values, NULL if off
+extern value_store_t *value_store;
+//text dump, binary event log or value store is open
+extern bool dump_enabled;
+//edge index being written, NULL if off
+extern edge_index_writer_t *edge_index;
+//runtime counters, set during processing
+extern monitor_t *monitor;
+//shared memory state export, NULL if off
+extern telemetry_writer_t *telemetry;
+//pre-trigger history, NULL if no triggers
+extern history_t *history;
+
+
+//probe(logic input) data and timing
+typedef struct probe_data{
+        int64_t time;
+        int last_value;
+
+        int64_t rising_edge_time;
+        int64_t falling_edge_time;
+        long long pulse_count;
+
+        uint8_t protocol;//PROTOCOL_*, PROTOCOL_OFF if not decoded
+        int is_sbus_active;
+        int64_t sbus_start_time;
+        bool sbus_start_checked;
+        int64_t sbus_count_from;//start bit high samples are counted from this time
+        int64_t sbus_busy_time;//last time used by previous byte, next start edge must be later
+        int sbus_bit_counter;
+        int start_bit_count;
+        int sbus_errors;
+        long long sbus_bytes;
+        uint16_t sbus_bits;
+        int parity;
+        int parity_errors;
+        int stop_bits;
+        int64_t sbus_last_byte_time;
+        int sbus_byte_counter;
+        uint8_t sbus_packet[MAX_SBUS_PACKET_SIZE];
+
+        int64_t sbus_packet_time;//first byte of current packet
+        long long sbus_frames;//completed non-empty packets
+        sbus_stats_t sbus_stats;
+        int sbus_byte_counter_last;
+        uint8_t sbus_packet_last[MAX_SBUS_PACKET_SIZE];
+
+        int dshot_one_min;//minimal high samples of '1' bit
+        int dshot_high_max;//longer high is not dshot bit
+        int dshot_period_min;//shorter time between bit starts breaks frame
+        int dshot_gap_max;//longer time between bit starts ends frame
+        int64_t dshot_rise_time;//last bit start, -1 if line is idle
+        int64_t dshot_frame_time;//first bit start of current frame
+        int dshot_bit_counter;
+        uint16_t dshot_bits;
+        dshot_stats_t dshot_stats;
+
+        average_data_t pulse_width_avg;
+        average_data_t period_avg;
+
+        //whole capture distributions
+        histogram_t width_hist;
+        histogram_t period_hist;
+        histogram_t jitter_hist;//cycle-to-cycle period difference
+
+        event_buffer_t *events;//dump events of probe owner
+
+} probe_data_t;
+
+//working context, all inputs/probes data
+typedef struct context{
+        int probes_n;
+        int unitsize;//bytes per sample
+        uint32_t probe_mask;//decoded probes
+        uint8_t protocols[MAX_PROBES];//protocol of every probe, PROTOCOL_OFF probes are not in probe_mask
+        int dshot_bit_fp[MAX_PROBES];//dshot bit length of probe in samples, 16.16 fixed point
+        int protocol;//protocol of all decoded probes, PROTOCOL_MIXED if they differ
+        probe_data_t probes[MAX_PROBES];
+        int bit_interval_fp;//sbus bit length in samples, 16.16 fixed point
+        int sbus_check_shift;//start bit check time after start edge
+        int sbus_start_min;//minimal high samples in start bit
+        int sbus_sample_shift[SBUS_BYTE_SAMPLES];//bit sampling times after start edge
+        int max_time;
+        int64_t line_num;
+        int64_t first_sample;//time of first decoded sample
+        long long edges_n;//decoded transitions
+        uint32_t triggers;//TRIGGER_* kinds counted by decoders
+        int width_min;//pwm pulse width range in samples, TRIGGER_WIDTH outside
+        int width_max;
+} context_t;
+
+//decoder of probes subset, owns edges and dump events buffers
+typedef struct decoder {
+        uint32_t probe_mask;
+        edge_detector_t detector;
+        edge_t edges[EDGE_BUFFER_SIZE];
+        long long edges_n;
+        event_buffer_t events;
+        history_t *history;//extracted edges are recorded, NULL if history is fed by other stage
+} decoder_t;
+
+
+int init_probes(context_t *ctx, int probe_idx);
+void free_probes(context_t *ctx);
+
+//attach decoder to probes in mask
+void init_decoder(decoder_t *dec, context_t *ctx, uint32_t probe_mask);
+void free_decoder(decoder_t *dec);
+
+//decode block of samples (ctx->unitsize bytes each) on decoder probes, block[0] has time base_time
+void decode_block(context_t *ctx, decoder_t *dec, const uint8_t *block, size_t samples, int64_t base_time);
+
+//decode already extracted edges in time order, then finish block at end_time
+void decode_edges(context_t *ctx, const edge_t *edges, int n);
+void decode_end(context_t *ctx, decoder_t *dec, int64_t end_time);
+
+void dump_result(context_t *ctx, int samplerate, bool brief);
+void dump_result_sbus(context_t *ctx, int samplerate);
+void dump_result_dshot(context_t *ctx, int samplerate);
+//completed frames of all protocols
+long long count_frames(const probe_data_t *probes, int probes_n);
+
+//dump results of every protocol in use
+void dump_results(context_t *ctx, int samplerate, bool brief);
+
+//write decoded events of output stage to text dump, binary event log and value store
+void output_events(event_buffer_t **buffers, int buffers_n);
+
+//calc timespec diff in ms
+int diffts(struct timespec start, struct timespec end);
+
+//process incoming data with reader, decoder and output threads, display may be NULL
+int process_data_threaded(context_t *ctx, input_t *in, display_t *display, int threads);
+
+//process mapped file, edges of consecutive blocks are extracted in parallel and decoded in order
+int process_data_chunked(context_t *ctx, input_t *in, display_t *display, int threads);
+
+//process several streams on common time base, display may be NULL
+int process_data_merged(context_t *ctx, merge_t *m, display_t *display);
+
+#endif
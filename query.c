@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <getopt.h>
+
+#include "store.h"
+
+//value store (pwm -V) query: values of one column in time range, or aggregates using block summaries,
+//only blocks overlapping time range boundaries are decoded
+
+
+typedef struct aggregate {
+        long long count;
+        int32_t min;
+        int32_t max;
+        int64_t sum;
+        double sum_squares;
+        int blocks;//blocks in time range
+        int decoded;//blocks decoded because they cross time range boundary
+} aggregate_t;
+
+
+static const char *protocol_name(int protocol){
+        switch(protocol){
+        case PROTOCOL_PWM:
+                return "pwm";
+        case PROTOCOL_SBUS:
+                return "sbus";
+        case PROTOCOL_DSHOT:
+                return "dshot";
+        }
+        return "unknown";
+}
+
+
+//column of probe by name, -1 if protocol of probe has no such column
+static int find_column(value_store_reader_t *r, int probe, const char *name){
+        for(int c=0;c<VALUE_STORE_COLUMNS;c++){
+                const char *column_name = value_column_name(r->header.protocols[probe], c);
+                if(column_name!=NULL && strcmp(column_name, name)==0){
+                        return c;
+                }
+        }
+        return -1;
+}
+
+
+static void aggregate_value(aggregate_t *a, int32_t value){
+        if(a->count==0 || value<a->min){
+                a->min = value;
+        }
+        if(a->count==0 || value>a->max){
+                a->max = value;
+        }
+        a->count++;
+        a->sum += value;
+        a->sum_squares += (double)value*value;
+}
+
+
+//aggregate values of column in [start, end), blocks inside of range are taken from summaries
+static void aggregate_column(value_store_reader_t *r, int probe, int column, int64_t start, int64_t end,
+                aggregate_t *a, int64_t *times, int32_t *values){
+        memset(a, 0, sizeof(aggregate_t));
+        for(uint32_t i=0;i<r->blocks;i++){
+                const value_store_block_t *b = &r->seek[i];
+                if(b->probe!=probe || b->column!=column || b->last_time<start || b->first_time>=end){
+                        continue;
+                }
+                a->blocks++;
+                if(b->first_time>=start && b->last_time<end){
+                        if(a->count==0 || b->min<a->min){
+                                a->min = b->min;
+                        }
+                        if(a->count==0 || b->max>a->max){
+                                a->max = b->max;
+                        }
+                        a->count += b->count;
+                        a->sum += b->sum;
+                        a->sum_squares += b->sum_squares;
+                        continue;
+                }
+                a->decoded++;
+                int n = value_store_read_block(r, b, times, values);
+                for(int k=0;k<n;k++){
+                        if(times[k]>=start && times[k]<end){
+                                aggregate_value(a, values[k]);
+                        }
+                }
+        }
+}
+
+
+//print values of column in [start, end) as csv
+static void print_values(value_store_reader_t *r, int probe, int column, int64_t start, int64_t end,
+                int64_t *times, int32_t *values){
+        double rate = r->header.samplerate;
+        printf("time,value\n");
+        for(uint32_t i=0;i<r->blocks;i++){
+                const value_store_block_t *b = &r->seek[i];
+                if(b->probe!=probe || b->column!=column || b->last_time<start || b->first_time>=end){
+                        continue;
+                }
+                int n = value_store_read_block(r, b, times, values);
+                for(int k=0;k<n;k++){
+                        if(times[k]>=start && times[k]<end){
+                                printf("%.6f,%d\n", times[k]/rate, values[k]);
+                        }
+                }
+        }
+}
+
+
+//print columns of store with block and compression statistics
+static void list_columns(value_store_reader_t *r, uint32_t probe_mask){
+        double rate = r->header.samplerate;
+        printf("samplerate %llu Hz, values %llu, blocks %u\n", (unsigned long long)r->header.samplerate,
+                (unsigned long long)r->header.values, r->blocks);
+        for(int p=0;p<VALUE_STORE_PROBES;p++){
+                if(!(probe_mask & r->header.probe_mask & (1U<<p))){
+                        continue;
+                }
+                for(int c=0;c<VALUE_STORE_COLUMNS;c++){
+                        long long count = 0;
+                        uint64_t bytes = 0;
+                        int blocks = 0;
+                        int64_t first = 0, last = 0;
+                        for(uint32_t i=0;i<r->blocks;i++){
+                                const value_store_block_t *b = &r->seek[i];
+                                if(b->probe!=p || b->column!=c){
+                                        continue;
+                                }
+                                if(blocks==0){
+                                        first = b->first_time;
+                                }
+                                last = b->last_time;
+                                count += b->count;
+                                bytes += b->size;
+                                blocks++;
+                        }
+                        if(blocks==0){
+                                continue;
+                        }
+                        const char *name = value_column_name(r->header.protocols[p], c);
+                        printf("p:%d %s %s values:%lld blocks:%d bytes/value:%.2f time:%.6f-%.6f\n", p,
+                                protocol_name(r->header.protocols[p]), name ? name : "?", count, blocks,
+                                (double)bytes/count, first/rate, last/rate);
+                }
+        }
+}
+
+
+static void show_help(){
+        printf("pwmquery: query columnar value store written by pwm -V\n");
+        printf(" Usage: pwmquery -i value_store [-l] [-a] [-p probe] [-c column] [-t start_s] [-e end_s] [-h]\n");
+        printf("  -l  list columns with value counts and time ranges\n");
+        printf("  -a  aggregate count, min, max, average and rmsd, of -c column or of all probe columns\n");
+        printf("      blocks inside of time range are aggregated from block summaries without decoding\n");
+        printf("  -p  probe, needed for values and aggregates\n");
+        printf("  -c  column: width, period (pwm, samples), ch1..ch16, flags (sbus), value (dshot)\n");
+        printf("  -t  start of time range in seconds (default 0)\n");
+        printf("  -e  end of time range in seconds (default end of capture)\n");
+        printf("  without -l and -a, values of -p probe -c column are printed as csv time,value\n");
+}
+
+
+int main(int argc, char **argv){
+        const char *path = NULL;
+        const char *column_name = NULL;
+        int probe = -1;
+        double start_seconds = 0;
+        double end_seconds = -1;
+        bool list = false;
+        bool aggregate = false;
+        int ch;
+        while((ch = getopt(argc, argv, "hi:lap:c:t:e:")) != -1){
+                switch(ch){
+                case 'h':
+                        show_help();
+                        return 0;
+                case 'i':
+                        path = optarg;
+                        break;
+                case 'l':
+                        list = true;
+                        break;
+                case 'a':
+                        aggregate = true;
+                        break;
+                case 'p':
+                        probe = atoi(optarg);
+                        if(probe<0 || probe>=VALUE_STORE_PROBES){
+                                fprintf(stderr, "invalid probe %s\n", optarg);
+                                return 1;
+                        }
+                        break;
+                case 'c':
+                        column_name = optarg;
+                        break;
+                case 't':
+                        start_seconds = atof(optarg);
+                        break;
+                case 'e':
+                        end_seconds = atof(optarg);
+                        break;
+                default:
+                        show_help();
+                        return 1;
+                }
+        }
+        if(path==NULL){
+                show_help();
+                return 1;
+        }
+
+        value_store_reader_t r;
+        if(value_store_open(&r, path)){
+                return 1;
+        }
+        if(list){
+                list_columns(&r, probe>=0 ? 1U<<probe : UINT32_MAX);
+                value_store_close_reader(&r);
+                return 0;
+        }
+        if(probe<0 || !(r.header.probe_mask & (1U<<probe))){
+                fprintf(stderr, "probe is not in store, see -l\n");
+                value_store_close_reader(&r);
+                return 1;
+        }
+        int column = -1;
+        if(column_name!=NULL){
+                column = find_column(&r, probe, column_name);
+                if(column<0){
+                        fprintf(stderr, "no column %s of %s probe %d\n", column_name, protocol_name(r.header.protocols[probe]), probe);
+                        value_store_close_reader(&r);
+                        return 1;
+                }
+        } else if(!aggregate){
+                fprintf(stderr, "values need -c column\n");
+                value_store_close_reader(&r);
+                return 1;
+        }
+        double rate = r.header.samplerate;
+        int64_t start = start_seconds*rate;
+        int64_t end = end_seconds>=0 ? (int64_t)(end_seconds*rate) : INT64_MAX;
+
+        int64_t *times = malloc(VALUE_STORE_BLOCK_VALUES*sizeof(int64_t));
+        int32_t *values = malloc(VALUE_STORE_BLOCK_VALUES*sizeof(int32_t));
+        if(times==NULL || values==NULL){
+                fprintf(stderr, "error allocate values\n");
+                value_store_close_reader(&r);
+                return 1;
+        }
+        if(aggregate){
+                for(int c=0;c<VALUE_STORE_COLUMNS;c++){
+                        const char *name = value_column_name(r.header.protocols[probe], c);
+                        if(name==NULL || (column>=0 && c!=column)){
+                                continue;
+                        }
+                        aggregate_t a;
+                        aggregate_column(&r, probe, c, start, end, &a, times, values);
+                        printf("p:%d %s count:%lld", probe, name, a.count);
+                        if(a.count>0){
+                                double average = (double)a.sum/a.count;
+                                double variance = a.sum_squares/a.count - average*average;
+                                printf(" min:%d max:%d avg:%f rmsd:%f", a.min, a.max, average, variance>0 ? sqrt(variance) : 0);
+                        }
+                        printf(" blocks:%d decoded:%d\n", a.blocks, a.decoded);
+                }
+        } else {
+                print_values(&r, probe, column, start, end, times, values);
+        }
+        free(times);
+        free(values);
+        value_store_close_reader(&r);
+        return 0;
+}
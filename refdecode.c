@@ -0,0 +1,718 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+#include <getopt.h>
+
+//reference decoder for differential tests (make check):
+//original per-sample pwm and sbus decoders and per-sample dshot decoder, every probe bit of every sample
+//is fed to state machine, no edge extraction, blocks, threads or fixed point timing
+//averages (sorted window median, two pass mean and rmsd), sbus packet print and dshot frame decoding
+//are own code of reference, no pwm object is linked, so a bug shared with pwm can not hide
+//output has format of pwm -d dump and pwm summary, so results of edge based decoders can be compared exactly
+
+#define MAX_PROBES 32
+#define MAX_SBUS_PACKET_SIZE 128
+#define READ_SIZE 65536
+
+#define PROTOCOL_PWM 0
+#define PROTOCOL_SBUS 1
+#define PROTOCOL_DSHOT 2
+#define PROTOCOL_OFF 3
+#define PROTOCOLS 3
+
+#define DSHOT_FRAME_BITS 16
+#define DSHOT_MIN_THROTTLE 48
+
+//window size for averaging
+static int average_n = 10;
+static FILE *dump_file = NULL;
+
+//sliding window average as in original decoder
+typedef struct average_data {
+        int window_size;
+        int data_count;
+        int circular_index;
+        int *buffer;//last window_size values
+        int *sorted;//window copy for median
+
+        double average;
+        double rmsd;
+
+        int last_value;
+        int median;
+        int min_value;
+        int max_value;
+        int min_value_filtered;
+        int max_value_filtered;
+} average_data_t;
+
+typedef struct ref_probe {
+        int protocol;
+
+        int64_t time;
+        int last_value;
+
+        int64_t rising_edge_time;
+        int64_t falling_edge_time;
+        long long pulse_count;
+
+        int is_sbus_active;
+        int64_t sbus_start_time;
+        int sbus_bit_counter;
+        int start_bit_count;
+        int sbus_errors;
+        long long sbus_bytes;
+        uint16_t sbus_bits;
+        int parity;
+        int parity_errors;
+        int stop_bits;
+        int64_t sbus_last_byte_time;
+        int sbus_byte_counter;
+        uint8_t sbus_packet[MAX_SBUS_PACKET_SIZE];
+
+        int sbus_byte_counter_last;
+        uint8_t sbus_packet_last[MAX_SBUS_PACKET_SIZE];
+
+        //dshot bit thresholds in samples
+        int dshot_one_min;
+        int dshot_high_max;
+        int dshot_period_min;
+        int dshot_gap_max;
+        int64_t dshot_rise_time;
+        int64_t dshot_frame_time;
+        int dshot_bit_counter;
+        uint16_t dshot_bits;
+
+        //dshot frame statistics
+        long long dshot_frames;
+        int dshot_crc_errors;
+        int dshot_bit_errors;
+        int dshot_commands;
+        int dshot_telemetry;
+        int64_t dshot_last_frame_time;
+        int dshot_last_throttle;
+        int dshot_last_telemetry;
+        average_data_t dshot_interval;
+        average_data_t dshot_throttle;
+
+        average_data_t pulse_width_avg;
+        average_data_t period_avg;
+} ref_probe_t;
+
+typedef struct ref_context {
+        int probes_n;
+        ref_probe_t probes[MAX_PROBES];
+        int bit_interval;//samples per sbus bit
+        int64_t line_num;
+} ref_context_t;
+
+
+//init averaging structure for window of window_size values, returns 0 on success
+static int init_average(average_data_t *avg, int window_size){
+        memset(avg, 0, sizeof(average_data_t));
+        avg->window_size = window_size;
+        avg->min_value = INT_MAX;
+        avg->max_value = INT_MIN;
+        avg->min_value_filtered = INT_MAX;
+        avg->max_value_filtered = INT_MIN;
+        avg->buffer = malloc(sizeof(int)*window_size);
+        avg->sorted = malloc(sizeof(int)*window_size);
+        return avg->buffer==NULL || avg->sorted==NULL;
+}
+
+
+static void free_average(average_data_t *avg){
+        free(avg->buffer);
+        free(avg->sorted);
+        avg->buffer = NULL;
+        avg->sorted = NULL;
+}
+
+
+//qsort comparer for median filter
+static int cmp_int(const void *p1, const void *p2){
+        int a = *(const int *)p1;
+        int b = *(const int *)p2;
+        return (a>b) - (a<b);
+}
+
+
+//average has enough samples to work with?
+static bool average_has_enough_data(average_data_t *avg){
+        return avg->data_count>=avg->window_size;
+}
+
+
+//update averages with new sample, window is copied oldest first, mean and rmsd are computed in two passes
+static void update_average(average_data_t *avg, int value){
+        int n = avg->window_size;
+        avg->last_value = value;
+        avg->buffer[avg->circular_index] = value;
+        avg->circular_index = (avg->circular_index+1) % n;
+        avg->data_count++;
+        if(value<avg->min_value){
+                avg->min_value = value;
+        }
+        if(value>avg->max_value){
+                avg->max_value = value;
+        }
+        if(avg->data_count<n){
+                return;
+        }
+
+        for(int i=0;i<n;i++){
+                avg->sorted[i] = avg->buffer[(avg->circular_index+i) % n];
+        }
+        double sum = 0;
+        for(int i=0;i<n;i++){
+                sum += avg->sorted[i];
+        }
+        avg->average = sum/n;
+        double deviation = 0;
+        for(int i=0;i<n;i++){
+                double d = avg->sorted[i]-avg->average;
+                deviation += d*d;
+        }
+        avg->rmsd = sqrt(deviation/n);
+
+        qsort(avg->sorted, n, sizeof(int), cmp_int);
+        avg->median = avg->sorted[n/2];
+        if(avg->median<avg->min_value_filtered){
+                avg->min_value_filtered = avg->median;
+        }
+        if(avg->median>avg->max_value_filtered){
+                avg->max_value_filtered = avg->median;
+        }
+}
+
+
+//print sbus packet bits with 11 bit channel values and flags of byte 23, as pwm dump does
+static void decode_sbus_packet(FILE *f, const uint8_t *packet, int len){
+        if(len!=25 || packet[0]!=0xF0){
+                fprintf(f, "not SBus packet\n");
+                return;
+        }
+        int value = 0;
+        int bits = 0;
+        int channel = 0;
+        for(int i=1;i<23;i++){
+                for(int j=0;j<8;j++){
+                        int bit = (packet[i]>>j) & 1;
+                        fprintf(f, "%d", bit);
+                        //lsb first
+                        value = (value>>1) | (bit<<10);
+                        if(++bits==11){
+                                fprintf(f, " [%4d] ", value);
+                                bits = 0;
+                                value = 0;
+                                if(++channel==8){
+                                        fprintf(f, "\n");
+                                }
+                        }
+                }
+        }
+        fprintf(f, "\n");
+        uint8_t b = packet[23];
+        fprintf(f, "d17:%d d18:%d loss:%d f/s:%d\n", (b>>7) & 1, (b>>6) & 1, (b>>5) & 1, (b>>4) & 1);
+}
+
+
+static void feed_bit(ref_context_t *ctx, int probe_idx, ref_probe_t *data, int value){
+        if(data->last_value!=0 && value==0){
+                //falling edge
+                if(data->rising_edge_time>=0){
+                        update_average(&data->pulse_width_avg, data->time - data->rising_edge_time);
+                }
+                data->falling_edge_time = data->time;
+        }
+        if(data->last_value==0 && value!=0){
+                //rising edge
+                if(data->rising_edge_time>=0){
+                        update_average(&data->period_avg, data->time - data->rising_edge_time);
+                        data->pulse_count++;
+                }
+                data->rising_edge_time = data->time;
+                if(dump_file!=NULL && data->pulse_count>=average_n){
+                        fprintf(dump_file, "%d,%lld,%lld,%d,%d,%d,%d,%f,%f,%f,%f\n",
+                                probe_idx, (long long)ctx->line_num, (long long)data->time,
+                                data->pulse_width_avg.last_value, data->period_avg.last_value,
+                                data->pulse_width_avg.median, data->period_avg.median,
+                                data->pulse_width_avg.average, data->period_avg.average,
+                                data->pulse_width_avg.rmsd, data->period_avg.rmsd);
+                }
+        }
+        data->last_value = value;
+        data->time++;
+}
+
+
+static void check_sbus_byte(ref_context_t *ctx, int probe_idx, ref_probe_t *data){
+        if(data->parity!=1){
+                data->parity_errors++;
+                return;
+        }
+        if((data->time - data->sbus_last_byte_time) > 22*ctx->bit_interval){
+                data->sbus_byte_counter_last = data->sbus_byte_counter;
+                memcpy(data->sbus_packet_last, data->sbus_packet, sizeof(data->sbus_packet));
+                if(dump_file!=NULL){
+                        fprintf(dump_file, "t:%8.8llx p:%d data:", (unsigned long long)data->time, probe_idx);
+                        for(int i=0;i<data->sbus_byte_counter;i++){
+                                fprintf(dump_file, "%2.2x ", data->sbus_packet[i]);
+                        }
+                        fprintf(dump_file, "\n");
+                        decode_sbus_packet(dump_file, data->sbus_packet, data->sbus_byte_counter);
+                }
+                data->sbus_byte_counter = 0;
+        }
+        if(data->sbus_byte_counter<MAX_SBUS_PACKET_SIZE){
+                data->sbus_packet[data->sbus_byte_counter++] = data->sbus_bits & 0xFF;
+        }
+        data->sbus_last_byte_time = data->time;
+        data->sbus_bytes++;
+}
+
+
+static void process_sbus_bit(ref_context_t *ctx, int probe_idx, ref_probe_t *data, int value){
+        int64_t shift = data->time - data->sbus_start_time;
+        if(shift<ctx->bit_interval){
+                if(value){
+                        data->start_bit_count++;
+                }
+                return;
+        }
+        if(data->start_bit_count < ctx->bit_interval/2){
+                data->is_sbus_active = 0;
+                data->sbus_errors++;
+                return;
+        }
+        if(((shift + ctx->bit_interval/2) % ctx->bit_interval)==0){
+                //sample bit
+                int bit_value = value ? 1 : 0;
+                if(data->sbus_bit_counter<8){
+                        data->sbus_bits >>= 1;
+                        data->sbus_bits |= bit_value ? 0x80 : 0x00;
+                }
+                if(data->sbus_bit_counter<9){
+                        data->parity ^= bit_value;
+                }
+                if(data->sbus_bit_counter>=9 && !bit_value){
+                        data->stop_bits++;
+                }
+                data->sbus_bit_counter++;
+                if(data->sbus_bit_counter>=11){
+                        check_sbus_byte(ctx, probe_idx, data);
+                        data->is_sbus_active = 0;
+                }
+        }
+}
+
+
+static void feed_bit_sbus(ref_context_t *ctx, int probe_idx, ref_probe_t *data, int value){
+        if(data->is_sbus_active){
+                process_sbus_bit(ctx, probe_idx, data, value);
+        } else if(data->last_value==0 && value!=0){
+                //rising edge, start sbus decode
+                data->is_sbus_active = 1;
+                data->sbus_start_time = data->time;
+                data->sbus_bits = 0;
+                data->sbus_bit_counter = 0;
+                data->start_bit_count = 0;
+                data->parity = 0;
+                data->stop_bits = 0;
+        }
+        data->last_value = value;
+        data->time++;
+}
+
+
+static void dshot_frame(int probe_idx, ref_probe_t *data){
+        //16 bits msb first: 11 bit throttle, telemetry request, crc of the three nibbles before it
+        int value = data->dshot_bits>>4;
+        int throttle = value>>1;
+        int telemetry = value & 1;
+        int crc = (value ^ (value>>4) ^ (value>>8)) & 0x0F;
+        bool crc_ok = crc==(data->dshot_bits & 0x0F);
+        if(dump_file!=NULL){
+                fprintf(dump_file, "t:%8.8llx p:%d dshot:%4.4x throttle:%d telemetry:%d crc:%s\n", (unsigned long long)data->dshot_frame_time,
+                        probe_idx, data->dshot_bits, throttle, telemetry, crc_ok ? "ok" : "error");
+        }
+        if(!crc_ok){
+                data->dshot_crc_errors++;
+                return;
+        }
+        data->dshot_frames++;
+        if(telemetry){
+                data->dshot_telemetry++;
+        }
+        if(throttle<DSHOT_MIN_THROTTLE){
+                data->dshot_commands++;
+        } else {
+                update_average(&data->dshot_throttle, throttle);
+        }
+        if(data->dshot_last_frame_time>=0){
+                int64_t interval = data->dshot_frame_time - data->dshot_last_frame_time;
+                update_average(&data->dshot_interval, interval>INT_MAX ? INT_MAX : (int)interval);
+        }
+        data->dshot_last_frame_time = data->dshot_frame_time;
+        data->dshot_last_throttle = throttle;
+        data->dshot_last_telemetry = telemetry;
+}
+
+
+//every bit starts with rising edge, high time tells '0' from '1', bit after too long high or
+//bit start out of bit timing drops partial frame
+static void feed_bit_dshot(int probe_idx, ref_probe_t *data, int value){
+        if(data->last_value==0 && value!=0){
+                //rising edge, start of bit
+                if(data->dshot_bit_counter>0){
+                        int64_t period = data->time - data->dshot_rise_time;
+                        if(period<data->dshot_period_min || period>data->dshot_gap_max){
+                                data->dshot_bit_errors++;
+                                data->dshot_bit_counter = 0;
+                        }
+                }
+                if(data->dshot_bit_counter==0){
+                        data->dshot_frame_time = data->time;
+                        data->dshot_bits = 0;
+                }
+                data->dshot_rise_time = data->time;
+        }
+        if(data->last_value!=0 && value==0 && data->dshot_rise_time>=0){
+                //falling edge, end of high part
+                int64_t width = data->time - data->dshot_rise_time;
+                if(width>data->dshot_high_max){
+                        data->dshot_bit_errors++;
+                        data->dshot_bit_counter = 0;
+                        data->dshot_rise_time = -1;
+                } else {
+                        data->dshot_bits = (data->dshot_bits<<1) | (width>=data->dshot_one_min);
+                        data->dshot_bit_counter++;
+                        if(data->dshot_bit_counter>=DSHOT_FRAME_BITS){
+                                dshot_frame(probe_idx, data);
+                                data->dshot_bit_counter = 0;
+                        }
+                }
+        }
+        data->last_value = value;
+        data->time++;
+}
+
+
+//dshot thresholds from exact bit length samplerate/rate, pwm uses fixed point bit length
+static void init_dshot_timing(ref_probe_t *probe, int samplerate, int rate){
+        //'0' is high for 3/8 of bit, '1' for 3/4, threshold in the middle
+        probe->dshot_one_min = (9*samplerate + 16*rate-1) / (16*rate);
+        probe->dshot_high_max = (samplerate + rate-1) / rate;
+        //bit starts follow at bit period inside of frame
+        probe->dshot_period_min = 3*samplerate / (4*rate);
+        probe->dshot_gap_max = (3*samplerate + 2*rate-1) / (2*rate);
+}
+
+
+static int init_probes(ref_context_t *ctx, int probes_n, const int *protocols, const int *dshot_rates, int samplerate){
+        memset(ctx->probes, 0, sizeof(ctx->probes));
+        for(int i=0;i<probes_n;i++){
+                ref_probe_t *probe = &ctx->probes[i];
+                probe->protocol = protocols[i];
+                probe->rising_edge_time = -1;
+                probe->falling_edge_time = -1;
+                probe->dshot_rise_time = -1;
+                probe->dshot_last_frame_time = -1;
+                if(probe->protocol==PROTOCOL_DSHOT){
+                        init_dshot_timing(probe, samplerate, dshot_rates[i]);
+                }
+                if(init_average(&probe->period_avg, average_n) || init_average(&probe->pulse_width_avg, average_n) ||
+                   init_average(&probe->dshot_interval, average_n) || init_average(&probe->dshot_throttle, average_n)){
+                        fprintf(stderr, "error allocate averages\n");
+                        return 1;
+                }
+        }
+        ctx->probes_n = probes_n;
+        return 0;
+}
+
+
+static void dump_average(char *name, average_data_t *avg, int samplerate){
+        printf("%s:", name);
+        if(!average_has_enough_data(avg)){
+                printf("no data\n");
+                return;
+        }
+        printf("avg:%f rmsd:%f median:%d min:%d max:%d min_f:%d max_f:%d\n", avg->average, avg->rmsd, avg->median,
+                avg->min_value, avg->max_value, avg->min_value_filtered, avg->max_value_filtered);
+        if(samplerate>0){
+                printf("%s:", name);
+                double koeff = 1000.0/samplerate;
+                printf("avg:%f rmsd:%f median:%f min:%f max:%f min_f:%f max_f:%f\n", avg->average*koeff, avg->rmsd*koeff, avg->median*koeff,
+                        avg->min_value*koeff, avg->max_value*koeff, avg->min_value_filtered*koeff, avg->max_value_filtered*koeff);
+        }
+        printf("\n");
+}
+
+
+static void dump_result(ref_context_t *ctx, int samplerate){
+        for(int i=0;i<ctx->probes_n;i++){
+                ref_probe_t *probe = &ctx->probes[i];
+                if(probe->protocol!=PROTOCOL_PWM){
+                        continue;
+                }
+                printf("p: %d ", i);
+                if(probe->pulse_count<average_n){
+                        printf("no data\n");
+                        continue;
+                }
+                printf("pulses:%lld\n", probe->pulse_count);
+                dump_average("  width:  ", &probe->pulse_width_avg, samplerate);
+                dump_average("  period: ", &probe->period_avg, samplerate);
+        }
+}
+
+
+static void dump_result_sbus(ref_context_t *ctx){
+        for(int i=0;i<ctx->probes_n;i++){
+                ref_probe_t *probe = &ctx->probes[i];
+                if(probe->protocol!=PROTOCOL_SBUS){
+                        continue;
+                }
+                printf("p:%d errors:%d parity_errors:%d bytes:%lld packet:%d\n", i, probe->sbus_errors, probe->parity_errors,
+                        probe->sbus_bytes, probe->sbus_byte_counter_last);
+                if(probe->sbus_byte_counter_last>0){
+                        for(int j=0;j<probe->sbus_byte_counter_last;j++){
+                                printf("%2.2x ", probe->sbus_packet_last[j]);
+                        }
+                        printf("\n");
+                        decode_sbus_packet(stdout, probe->sbus_packet_last, probe->sbus_byte_counter_last);
+                }
+        }
+}
+
+
+static void dump_result_dshot(ref_context_t *ctx, int samplerate){
+        for(int i=0;i<ctx->probes_n;i++){
+                ref_probe_t *probe = &ctx->probes[i];
+                if(probe->protocol!=PROTOCOL_DSHOT){
+                        continue;
+                }
+                average_data_t *interval = &probe->dshot_interval;
+                average_data_t *throttle = &probe->dshot_throttle;
+                printf("p:%d frames:%lld crc_errors:%d bit_errors:%d commands:%d telemetry:%d", i, probe->dshot_frames,
+                        probe->dshot_crc_errors, probe->dshot_bit_errors, probe->dshot_commands, probe->dshot_telemetry);
+                if(!average_has_enough_data(interval)){
+                        printf(" interval: no data");
+                } else if(samplerate>0){
+                        double ms = 1.0/samplerate;
+                        printf(" rate:%.2f Hz interval:%.3f ms jitter:%.1f us", 1000.0/(interval->average*ms),
+                                interval->average*ms, interval->rmsd*ms*1000);
+                }
+                printf("\n");
+                if(probe->dshot_frames==0){
+                        continue;
+                }
+                printf("throttle:%d telemetry:%d", probe->dshot_last_throttle, probe->dshot_last_telemetry);
+                if(!average_has_enough_data(throttle)){
+                        printf(" avg: no data");
+                } else {
+                        printf(" avg:%.1f median:%d min:%d max:%d", throttle->average, throttle->median,
+                                throttle->min_value, throttle->max_value);
+                }
+                printf("\n");
+        }
+}
+
+
+//parse "0-3:sbus,4:pwm,5:dshot600,6:off", returns 0 on success
+static int parse_protocols(const char *list, int *protocols, int *dshot_rates){
+        const char *p = list;
+        while(*p){
+                char *end;
+                long first = strtol(p, &end, 10);
+                long last = first;
+                if(*end=='-'){
+                        last = strtol(end+1, &end, 10);
+                }
+                if(end==p || *end!=':' || first<0 || last<first || last>=MAX_PROBES){
+                        return 1;
+                }
+                const char *name = end+1;
+                size_t len = strcspn(name, ",");
+                int protocol;
+                int rate = 0;
+                if(len==3 && strncmp(name, "pwm", 3)==0){
+                        protocol = PROTOCOL_PWM;
+                } else if(len==4 && strncmp(name, "sbus", 4)==0){
+                        protocol = PROTOCOL_SBUS;
+                } else if(len==3 && strncmp(name, "off", 3)==0){
+                        protocol = PROTOCOL_OFF;
+                } else if(len>5 && strncmp(name, "dshot", 5)==0 && (rate = atoi(name+5))>0){
+                        protocol = PROTOCOL_DSHOT;
+                } else {
+                        return 1;
+                }
+                for(long i=first;i<=last;i++){
+                        protocols[i] = protocol;
+                        dshot_rates[i] = rate;
+                }
+                p = name+len;
+                if(*p==','){
+                        p++;
+                }
+        }
+        return 0;
+}
+
+
+static void show_help(){
+        printf("pwmref: per-sample reference pwm/sbus/dshot decoder for differential tests of pwm\n");
+        printf(" Usage: pwmref -s samplerate_khz [-b | -x dshot_rate] [-p probe_protocols] [-u unitsize] [-n average_length] [-d data_dump_file] < sigrok_binary_file\n");
+        printf("  -p  protocol per probe as pwm -p, e.g. 0-3:sbus,4:pwm,5:dshot600,6:off, other probes use -b/-x protocol\n");
+        printf("  sbus needs samplerate multiple of 100k, bit sampling uses whole samples per bit\n");
+        printf("  dshot thresholds are exact fractions of bit length, equal to pwm for samplerate multiple of bit rate\n");
+}
+
+
+int main(int argc, char **argv){
+        static ref_context_t context;
+        int samplerate = 0;
+        int unitsize = 1;
+        int default_protocol = PROTOCOL_PWM;
+        int default_rate = 0;
+        const char *protocol_list = NULL;
+        int ch;
+
+        while((ch = getopt(argc, argv, "hs:bx:p:u:n:d:")) != -1){
+                switch(ch){
+                case 'h':
+                        show_help();
+                        return 0;
+                case 's':
+                        samplerate = atoi(optarg);
+                        break;
+                case 'b':
+                        default_protocol = PROTOCOL_SBUS;
+                        break;
+                case 'x':
+                        default_protocol = PROTOCOL_DSHOT;
+                        default_rate = atoi(optarg);
+                        break;
+                case 'p':
+                        protocol_list = optarg;
+                        break;
+                case 'u':
+                        unitsize = atoi(optarg);
+                        break;
+                case 'n':
+                        average_n = atoi(optarg);
+                        break;
+                case 'd':
+                        dump_file = fopen(optarg, "w");
+                        if(dump_file==NULL){
+                                fprintf(stderr, "error open %s %s\n", optarg, strerror(errno));
+                                return 1;
+                        }
+                        break;
+                default:
+                        show_help();
+                        return 1;
+                }
+        }
+        if(unitsize!=1 && unitsize!=2 && unitsize!=4){
+                fprintf(stderr, "invalid unitsize %d\n", unitsize);
+                return 1;
+        }
+        if(average_n<1){
+                fprintf(stderr, "invalid average length %d\n", average_n);
+                return 1;
+        }
+        int protocols[MAX_PROBES];
+        int dshot_rates[MAX_PROBES];
+        for(int i=0;i<MAX_PROBES;i++){
+                protocols[i] = default_protocol;
+                dshot_rates[i] = default_rate;
+        }
+        if(protocol_list!=NULL && parse_protocols(protocol_list, protocols, dshot_rates)){
+                fprintf(stderr, "invalid probe protocols %s\n", protocol_list);
+                return 1;
+        }
+        bool used[PROTOCOLS] = {false};
+        for(int i=0;i<unitsize*8;i++){
+                if(protocols[i]<PROTOCOLS){
+                        used[protocols[i]] = true;
+                }
+                if(protocols[i]==PROTOCOL_DSHOT && (dshot_rates[i]<=0 || samplerate<4*dshot_rates[i])){
+                        fprintf(stderr, "dshot needs rate and samplerate of at least 4 samples per bit\n");
+                        return 1;
+                }
+        }
+        context.bit_interval = samplerate/100;//sbus has 100000 bit per second
+        if(used[PROTOCOL_SBUS] && (context.bit_interval<10 || samplerate%100!=0)){
+                fprintf(stderr, "reference sbus decoder needs samplerate multiple of 100k, at least 1000k\n");
+                return 1;
+        }
+        context.line_num = 1;
+        if(init_probes(&context, unitsize*8, protocols, dshot_rates, samplerate)){
+                return 1;
+        }
+
+        uint8_t *buffer = malloc(READ_SIZE*unitsize);
+        if(buffer==NULL){
+                fprintf(stderr, "error allocate buffer\n");
+                return 1;
+        }
+        size_t n;
+        while((n = fread(buffer, unitsize, READ_SIZE, stdin))>0){
+                for(size_t s=0;s<n;s++){
+                        const uint8_t *p = buffer+s*unitsize;
+                        uint32_t sample = 0;
+                        for(int b=0;b<unitsize;b++){
+                                sample |= (uint32_t)p[b]<<(8*b);
+                        }
+                        for(int probe_idx=0;probe_idx<context.probes_n;probe_idx++){
+                                ref_probe_t *probe = &context.probes[probe_idx];
+                                int value = (sample>>probe_idx) & 1;
+                                switch(probe->protocol){
+                                case PROTOCOL_PWM:
+                                        feed_bit(&context, probe_idx, probe, value);
+                                        break;
+                                case PROTOCOL_SBUS:
+                                        feed_bit_sbus(&context, probe_idx, probe, value);
+                                        break;
+                                case PROTOCOL_DSHOT:
+                                        feed_bit_dshot(probe_idx, probe, value);
+                                        break;
+                                }
+                        }
+                        context.line_num++;
+                }
+        }
+        free(buffer);
+        if(ferror(stdin)){
+                fprintf(stderr, "error read input %s\n", strerror(errno));
+                return 1;
+        }
+
+        if(dump_file!=NULL){
+                fclose(dump_file);
+        }
+        if(used[PROTOCOL_PWM]){
+                dump_result(&context, samplerate);
+        }
+        if(used[PROTOCOL_SBUS]){
+                dump_result_sbus(&context);
+        }
+        if(used[PROTOCOL_DSHOT]){
+                dump_result_dshot(&context, samplerate);
+        }
+        for(int i=0;i<context.probes_n;i++){
+                free_average(&context.probes[i].period_avg);
+                free_average(&context.probes[i].pulse_width_avg);
+                free_average(&context.probes[i].dshot_interval);
+                free_average(&context.probes[i].dshot_throttle);
+        }
+        return 0;
+}
@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sbus.h"
+#include "edges.h"
+
+//channel i occupies bits 11*i..11*i+10 of data bytes 1..22, lsb first
+//every channel fits into 3 bytes starting at byte offset, shifted right by shift
+typedef struct sbus_channel_pos {
+        uint8_t offset;
+        uint8_t shift;
+} sbus_channel_pos_t;
+
+#define CH(i) { 1+(11*(i))/8, (11*(i))%8 }
+static const sbus_channel_pos_t sbus_channel_pos[SBUS_CHANNELS] = {
+        CH(0), CH(1), CH(2), CH(3), CH(4), CH(5), CH(6), CH(7),
+        CH(8), CH(9), CH(10), CH(11), CH(12), CH(13), CH(14), CH(15)
+};
+#undef CH
+
+
+//unpack frame bytes as stored by decoder (sampled line levels, so inverted uart bytes)
+//returns 0 if length, header and footer are valid
+int sbus_unpack(const uint8_t *packet, int length, sbus_frame_t *frame){
+        if(length!=SBUS_FRAME_SIZE){
+                return 1;
+        }
+        uint8_t header = ~packet[0];
+        uint8_t footer = ~packet[24];
+        if(header!=SBUS_HEADER || footer!=SBUS_FOOTER){
+                return 1;
+        }
+        for(int i=0;i<SBUS_CHANNELS;i++){
+                const uint8_t *p = packet+sbus_channel_pos[i].offset;
+                uint32_t word = ~(p[0] | (p[1]<<8) | (p[2]<<16));
+                frame->channels[i] = (word>>sbus_channel_pos[i].shift) & 0x7FF;
+        }
+        uint8_t flags = ~packet[23];
+        frame->ch17 = flags & SBUS_FLAG_CH17;
+        frame->ch18 = flags & SBUS_FLAG_CH18;
+        frame->lost = flags & SBUS_FLAG_LOST;
+        frame->failsafe = flags & SBUS_FLAG_FAILSAFE;
+        return 0;
+}
+
+
+//init statistics with interval averaging window, returns 0 on success
+int init_sbus_stats(sbus_stats_t *stats, int window_size){
+        memset(stats, 0, sizeof(sbus_stats_t));
+        stats->last_frame_time = -1;
+        for(int i=0;i<SBUS_CHANNELS;i++){
+                stats->channel_min[i] = 0x7FF;
+        }
+        return init_average(&stats->interval, window_size);
+}
+
+
+void free_sbus_stats(sbus_stats_t *stats){
+        free_average(&stats->interval);
+}
+
+
+//account frame which started at time
+void sbus_stats_update(sbus_stats_t *stats, const uint8_t *packet, int length, int64_t time){
+        sbus_frame_t frame;
+        if(sbus_unpack(packet, length, &frame)){
+                stats->bad_frames++;
+                return;
+        }
+        stats->frames++;
+        if(frame.lost){
+                stats->lost_frames++;
+        }
+        if(frame.failsafe){
+                stats->failsafe_frames++;
+        }
+        if(stats->last_frame_time>=0){
+                update_average(&stats->interval, time_delta(time, stats->last_frame_time));
+        }
+        stats->last_frame_time = time;
+        for(int i=0;i<SBUS_CHANNELS;i++){
+                uint16_t value = frame.channels[i];
+                if(value<stats->channel_min[i]){
+                        stats->channel_min[i] = value;
+                }
+                if(value>stats->channel_max[i]){
+                        stats->channel_max[i] = value;
+                }
+        }
+        stats->last = frame;
+}
+
+
+//print statistics, samplerate in kHz
+void dump_sbus_stats(sbus_stats_t *stats, int samplerate){
+        average_data_t *interval = &stats->interval;
+        printf("frames:%lld bad:%d lost:%d failsafe:%d", stats->frames, stats->bad_frames, stats->lost_frames, stats->failsafe_frames);
+        if(!average_has_enough_data(interval)){
+                printf(" interval: no data");
+        } else if(samplerate>0){
+                double ms = 1.0/samplerate;
+                printf(" rate:%.2f Hz interval:%.3f ms jitter:%.1f us min:%.3f max:%.3f",
+                       1000.0/(interval->average*ms), interval->average*ms, interval->rmsd*ms*1000,
+                       interval->min_value*ms, interval->max_value*ms);
+        }
+        printf("\n");
+        if(stats->frames==0){
+                return;
+        }
+        for(int i=0;i<SBUS_CHANNELS;i++){
+                printf("%2d:%4d [%4d-%4d]%s", i+1, stats->last.channels[i], stats->channel_min[i], stats->channel_max[i],
+                       (i & 3)==3 ? "\n" : "  ");
+        }
+        printf("17:%d 18:%d lost:%d failsafe:%d\n", stats->last.ch17, stats->last.ch18, stats->last.lost, stats->last.failsafe);
+}
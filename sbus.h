@@ -0,0 +1,57 @@
+#ifndef SBUS_H
+#define SBUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "average.h"
+
+//sbus frame: header 0x0F, 16 channels of 11 bits (lsb first), flags, footer 0x00
+#define SBUS_FRAME_SIZE 25
+#define SBUS_CHANNELS 16
+#define SBUS_HEADER 0x0F
+#define SBUS_FOOTER 0x00
+
+//flags byte
+#define SBUS_FLAG_CH17 0x01
+#define SBUS_FLAG_CH18 0x02
+#define SBUS_FLAG_LOST 0x04
+#define SBUS_FLAG_FAILSAFE 0x08
+
+typedef struct sbus_frame {
+        uint16_t channels[SBUS_CHANNELS];
+        bool ch17;
+        bool ch18;
+        bool lost;
+        bool failsafe;
+} sbus_frame_t;
+
+//per-probe frame statistics
+typedef struct sbus_stats {
+        long long frames;//valid frames
+        int bad_frames;//wrong length, header or footer
+        int lost_frames;
+        int failsafe_frames;
+        int64_t last_frame_time;//start of last valid frame, -1 before first frame
+        average_data_t interval;//samples between valid frame starts
+        uint16_t channel_min[SBUS_CHANNELS];
+        uint16_t channel_max[SBUS_CHANNELS];
+        sbus_frame_t last;
+} sbus_stats_t;
+
+
+//unpack frame bytes as stored by decoder (sampled line levels, so inverted uart bytes)
+//returns 0 if length, header and footer are valid
+int sbus_unpack(const uint8_t *packet, int length, sbus_frame_t *frame);
+
+//init statistics with interval averaging window, returns 0 on success
+int init_sbus_stats(sbus_stats_t *stats, int window_size);
+void free_sbus_stats(sbus_stats_t *stats);
+
+//account frame which started at time
+void sbus_stats_update(sbus_stats_t *stats, const uint8_t *packet, int length, int64_t time);
+
+//print statistics, samplerate in kHz
+void dump_sbus_stats(sbus_stats_t *stats, int samplerate);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "eventlog.h"
+#include "telemetry.h"
+
+//reader of pwm shared memory telemetry (pwm -M), prints snapshots as key=value lines
+
+
+static void show_help(){
+        printf("pwmshm: print live pwm state from shared memory\n");
+        printf(" Usage: pwmshm -n name [-i interval_ms] [-c count] [-h]\n");
+        printf("  -n  shared memory name given to pwm -M\n");
+        printf("  -i  print interval in ms (default 1000)\n");
+        printf("  -c  number of snapshots, 0 until pwm stops (default 0)\n");
+}
+
+
+static void print_snapshot(const telemetry_t *t){
+        const telemetry_header_t *h = &t->header;
+        double ms = h->samplerate>0 ? 1000.0/h->samplerate : 0;
+        printf("time=%.3f updates=%llu samples=%llu edges=%llu frames=%llu%s\n",
+               h->samplerate>0 ? (double)h->samples/h->samplerate : 0, (unsigned long long)h->updates,
+               (unsigned long long)h->samples, (unsigned long long)h->edges, (unsigned long long)h->frames,
+               h->state==TELEMETRY_RUNNING ? "" : " stopped");
+        for(int i=0;i<TELEMETRY_PROBES;i++){
+                const telemetry_probe_t *p = &t->probes[i];
+                if(!(h->probe_mask & (1U<<i))){
+                        continue;
+                }
+                if(p->protocol==PROTOCOL_PWM){
+                        printf("p=%d pwm pulses=%u width_ms=%.4f width_median_ms=%.4f width_rmsd_ms=%.4f period_ms=%.4f period_median_ms=%.4f period_rmsd_ms=%.4f\n",
+                               i, p->pulses, p->width*ms, p->width_median*ms, p->width_rmsd*ms,
+                               p->period*ms, p->period_median*ms, p->period_rmsd*ms);
+                } else if(p->protocol==PROTOCOL_SBUS){
+                        printf("p=%d sbus frames=%u bad=%u lost=%u failsafe=%u errors=%u parity_errors=%u interval_ms=%.3f channels=",
+                               i, p->sbus_frames, p->sbus_bad_frames, p->sbus_lost_frames, p->sbus_failsafe_frames,
+                               p->sbus_errors, p->sbus_parity_errors, p->sbus_interval*ms);
+                        for(int c=0;c<TELEMETRY_CHANNELS;c++){
+                                printf("%s%u", c ? ";" : "", p->channels[c]);
+                        }
+                        printf(" ch17=%u ch18=%u lost_flag=%u failsafe_flag=%u\n", p->ch17, p->ch18, p->lost, p->failsafe);
+                } else if(p->protocol==PROTOCOL_DSHOT){
+                        printf("p=%d dshot frames=%u crc_errors=%u bit_errors=%u interval_ms=%.3f throttle=%u telemetry=%u\n",
+                               i, p->dshot_frames, p->dshot_crc_errors, p->dshot_bit_errors, p->dshot_interval*ms,
+                               p->throttle, p->telemetry);
+                }
+        }
+        fflush(stdout);
+}
+
+
+int main(int argc, char **argv){
+        char name[256] = "";
+        int interval_ms = 1000;
+        int count = 0;
+        int ch;
+        while((ch = getopt(argc, argv, "hn:i:c:")) != -1){
+                switch(ch){
+                case 'h':
+                        show_help();
+                        return 0;
+                case 'n':
+                        snprintf(name, sizeof(name), "%s%s", optarg[0]=='/' ? "" : "/", optarg);
+                        break;
+                case 'i':
+                        interval_ms = atoi(optarg);
+                        break;
+                case 'c':
+                        count = atoi(optarg);
+                        break;
+                default:
+                        show_help();
+                        return 1;
+                }
+        }
+        if(name[0]==0 || interval_ms<=0){
+                show_help();
+                return 1;
+        }
+
+        int fd = shm_open(name, O_RDONLY, 0);
+        if(fd<0){
+                fprintf(stderr, "error open shared memory %s %s\n", name, strerror(errno));
+                return 1;
+        }
+        struct stat st;
+        if(fstat(fd, &st)!=0 || (size_t)st.st_size<sizeof(telemetry_t)){
+                fprintf(stderr, "shared memory %s is too small\n", name);
+                return 1;
+        }
+        const telemetry_t *shm = mmap(NULL, sizeof(telemetry_t), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(shm==MAP_FAILED){
+                fprintf(stderr, "error map shared memory %s %s\n", name, strerror(errno));
+                return 1;
+        }
+
+        telemetry_t *t = malloc(sizeof(telemetry_t));
+        if(t==NULL){
+                fprintf(stderr, "error allocate snapshot\n");
+                return 1;
+        }
+        for(int n=0;count==0 || n<count;n++){
+                telemetry_read(shm, t);
+                const telemetry_header_t *h = &t->header;
+                if(memcmp(h->magic, TELEMETRY_MAGIC, sizeof(h->magic))!=0 || h->version!=TELEMETRY_VERSION ||
+                   h->size!=sizeof(telemetry_t) || h->probe_size!=sizeof(telemetry_probe_t)){
+                        fprintf(stderr, "shared memory %s is not pwm telemetry version %d\n", name, TELEMETRY_VERSION);
+                        return 1;
+                }
+                print_snapshot(t);
+                if(h->state!=TELEMETRY_RUNNING){
+                        break;
+                }
+                struct timespec ts = {interval_ms/1000, (interval_ms%1000)*1000000L};
+                nanosleep(&ts, NULL);
+        }
+        free(t);
+        return 0;
+}
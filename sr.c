@@ -0,0 +1,444 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sr.h"
+
+#define ZIP_LOCAL_HEADER 0x04034b50
+#define ZIP_CENTRAL_HEADER 0x02014b50
+#define ZIP_END_OF_DIR 0x06054b50
+#define ZIP64_END_OF_DIR 0x06064b50
+#define ZIP64_LOCATOR 0x07064b50
+#define ZIP64_EXTRA 0x0001
+
+#define METHOD_STORED 0
+#define METHOD_DEFLATED 8
+
+
+static uint16_t get16(const uint8_t *p){
+        return p[0] | (p[1]<<8);
+}
+
+static uint32_t get32(const uint8_t *p){
+        return p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static uint64_t get64(const uint8_t *p){
+        return get32(p) | ((uint64_t)get32(p+4)<<32);
+}
+
+
+//file looks like zip archive?
+bool sr_is_session_file(const char *path){
+        //reading magic of fifo would consume stream data
+        struct stat st;
+        if(stat(path, &st)!=0 || !S_ISREG(st.st_mode)){
+                return false;
+        }
+        FILE *f = fopen(path, "rb");
+        if(f==NULL){
+                return false;
+        }
+        uint8_t magic[4];
+        bool r = fread(magic, 1, 4, f)==4 && get32(magic)==ZIP_LOCAL_HEADER;
+        fclose(f);
+        return r;
+}
+
+
+//read zip central directory
+static int read_directory(sr_file_t *sr){
+        const uint8_t *map = sr->map;
+        size_t size = sr->map_size;
+        if(size<22){
+                return 1;
+        }
+
+        //end of central directory record is at the end, before optional comment
+        size_t eocd = size-22;
+        size_t limit = size>22+65535 ? size-22-65535 : 0;
+        while(get32(map+eocd)!=ZIP_END_OF_DIR){
+                if(eocd==limit){
+                        return 1;
+                }
+                eocd--;
+        }
+        uint64_t entries = get16(map+eocd+10);
+        uint64_t dir_offset = get32(map+eocd+16);
+
+        //zip64 archive
+        if(eocd>=20 && get32(map+eocd-20)==ZIP64_LOCATOR){
+                uint64_t eocd64 = get64(map+eocd-20+8);
+                if(eocd64+56>size || get32(map+eocd64)!=ZIP64_END_OF_DIR){
+                        return 1;
+                }
+                entries = get64(map+eocd64+32);
+                dir_offset = get64(map+eocd64+48);
+        }
+
+        sr->entries = calloc(entries ? entries : 1, sizeof(sr_entry_t));
+        if(sr->entries==NULL){
+                return 1;
+        }
+        uint64_t pos = dir_offset;
+        for(uint64_t i=0;i<entries;i++){
+                if(pos+46>size || get32(map+pos)!=ZIP_CENTRAL_HEADER){
+                        return 1;
+                }
+                const uint8_t *h = map+pos;
+                int name_len = get16(h+28);
+                int extra_len = get16(h+30);
+                int comment_len = get16(h+32);
+                if(pos+46+name_len+extra_len+comment_len>size){
+                        return 1;
+                }
+                sr_entry_t *e = &sr->entries[sr->entries_n++];
+                e->method = get16(h+10);
+                e->compressed_size = get32(h+20);
+                e->size = get32(h+24);
+                e->header_offset = get32(h+42);
+                int len = name_len<SR_NAME_SIZE-1 ? name_len : SR_NAME_SIZE-1;
+                memcpy(e->name, h+46, len);
+                e->name[len] = 0;
+
+                //zip64 extra field holds 64-bit values of saturated fields
+                const uint8_t *extra = h+46+name_len;
+                const uint8_t *extra_end = extra+extra_len;
+                while(extra+4<=extra_end){
+                        int id = get16(extra);
+                        int field_len = get16(extra+2);
+                        const uint8_t *field = extra+4;
+                        if(field+field_len>extra_end){
+                                break;
+                        }
+                        if(id==ZIP64_EXTRA){
+                                const uint8_t *f = field;
+                                if(e->size==0xFFFFFFFF && f+8<=field+field_len){
+                                        e->size = get64(f);
+                                        f += 8;
+                                }
+                                if(e->compressed_size==0xFFFFFFFF && f+8<=field+field_len){
+                                        e->compressed_size = get64(f);
+                                        f += 8;
+                                }
+                                if(e->header_offset==0xFFFFFFFF && f+8<=field+field_len){
+                                        e->header_offset = get64(f);
+                                }
+                        }
+                        extra = field+field_len;
+                }
+                pos += 46+name_len+extra_len+comment_len;
+        }
+        return 0;
+}
+
+
+static sr_entry_t *find_entry(sr_file_t *sr, const char *name){
+        for(int i=0;i<sr->entries_n;i++){
+                if(strcmp(sr->entries[i].name, name)==0){
+                        return &sr->entries[i];
+                }
+        }
+        return NULL;
+}
+
+
+//start of entry data in mapped archive
+static const uint8_t *entry_data(sr_file_t *sr, sr_entry_t *e){
+        uint64_t pos = e->header_offset;
+        if(pos+30>sr->map_size || get32(sr->map+pos)!=ZIP_LOCAL_HEADER){
+                return NULL;
+        }
+        pos += 30+get16(sr->map+pos+26)+get16(sr->map+pos+28);
+        if(pos+e->compressed_size>sr->map_size){
+                return NULL;
+        }
+        return sr->map+pos;
+}
+
+
+//start streaming of entry data
+static int open_stream(sr_file_t *sr, sr_entry_t *e){
+        sr->data = entry_data(sr, e);
+        if(sr->data==NULL){
+                fprintf(stderr, "sr: broken entry %s\n", e->name);
+                return 1;
+        }
+        sr->data_left = e->compressed_size;
+        sr->method = e->method;
+        if(e->method==METHOD_DEFLATED){
+                memset(&sr->zs, 0, sizeof(z_stream));
+                if(inflateInit2(&sr->zs, -MAX_WBITS)!=Z_OK){
+                        fprintf(stderr, "sr: inflate init error\n");
+                        return 1;
+                }
+                sr->zs_active = true;
+        } else if(e->method!=METHOD_STORED){
+                fprintf(stderr, "sr: unsupported compression method %d of %s\n", e->method, e->name);
+                return 1;
+        }
+        return 0;
+}
+
+
+static void close_stream(sr_file_t *sr){
+        if(sr->zs_active){
+                inflateEnd(&sr->zs);
+                sr->zs_active = false;
+        }
+        sr->data = NULL;
+        sr->data_left = 0;
+}
+
+
+//read from current entry stream, returns bytes read, 0 on entry end, -1 on error
+static ssize_t read_stream(sr_file_t *sr, uint8_t *buffer, size_t size){
+        if(sr->method==METHOD_STORED){
+                size_t len = sr->data_left<size ? sr->data_left : size;
+                memcpy(buffer, sr->data, len);
+                sr->data += len;
+                sr->data_left -= len;
+                return len;
+        }
+
+        sr->zs.next_out = buffer;
+        sr->zs.avail_out = size;
+        while(sr->zs.avail_out>0){
+                if(sr->zs.avail_in==0 && sr->data_left>0){
+                        uInt chunk = sr->data_left>(1U<<30) ? (1U<<30) : sr->data_left;
+                        sr->zs.next_in = (Bytef*)sr->data;
+                        sr->zs.avail_in = chunk;
+                        sr->data += chunk;
+                        sr->data_left -= chunk;
+                }
+                int r = inflate(&sr->zs, Z_NO_FLUSH);
+                if(r==Z_STREAM_END){
+                        break;
+                }
+                if(r!=Z_OK){
+                        fprintf(stderr, "sr: inflate error %d\n", r);
+                        return -1;
+                }
+                if(sr->zs.avail_in==0 && sr->data_left==0){
+                        break;
+                }
+        }
+        return size-sr->zs.avail_out;
+}
+
+
+//parse samplerate string like "2 MHz", returns Hz
+static uint64_t parse_samplerate(const char *s){
+        char *end;
+        double value = strtod(s, &end);
+        while(*end==' '){
+                end++;
+        }
+        if(strncmp(end, "GHz", 3)==0){
+                value *= 1e9;
+        } else if(strncmp(end, "MHz", 3)==0){
+                value *= 1e6;
+        } else if(strncmp(end, "kHz", 3)==0){
+                value *= 1e3;
+        }
+        return (uint64_t)(value+0.5);
+}
+
+
+//parse metadata ini file, only first device section is used
+static int parse_metadata(sr_file_t *sr, char *text){
+        bool device = false;
+        bool done = false;
+        sr->unitsize = 1;
+        strcpy(sr->capturefile, "logic-1");
+        for(char *line=strtok(text, "\r\n"); line!=NULL && !done; line=strtok(NULL, "\r\n")){
+                if(line[0]=='['){
+                        if(device){
+                                done = true;
+                        }
+                        device = strncmp(line, "[device ", 8)==0;
+                        continue;
+                }
+                if(!device){
+                        continue;
+                }
+                char *eq = strchr(line, '=');
+                if(eq==NULL){
+                        continue;
+                }
+                *eq = 0;
+                char *key = line;
+                char *value = eq+1;
+                if(strcmp(key, "capturefile")==0){
+                        snprintf(sr->capturefile, SR_NAME_SIZE, "%s", value);
+                } else if(strcmp(key, "samplerate")==0){
+                        sr->samplerate = parse_samplerate(value);
+                } else if(strcmp(key, "unitsize")==0){
+                        sr->unitsize = atoi(value);
+                } else if(strcmp(key, "total probes")==0){
+                        sr->probes_n = atoi(value);
+                } else if(strncmp(key, "probe", 5)==0){
+                        int idx = atoi(key+5)-1;
+                        if(idx>=0 && idx<SR_MAX_PROBES){
+                                snprintf(sr->probe_names[idx], SR_NAME_SIZE, "%s", value);
+                        }
+                }
+        }
+        if(sr->unitsize!=1 && sr->unitsize!=2 && sr->unitsize!=4){
+                fprintf(stderr, "sr: unsupported unitsize %d\n", sr->unitsize);
+                return 1;
+        }
+        if(sr->probes_n<=0 || sr->probes_n>sr->unitsize*8){
+                sr->probes_n = sr->unitsize*8;
+        }
+        return 0;
+}
+
+
+//read whole metadata entry
+static int read_metadata(sr_file_t *sr){
+        sr_entry_t *e = find_entry(sr, "metadata");
+        if(e==NULL){
+                fprintf(stderr, "sr: no metadata in session file\n");
+                return 1;
+        }
+        char *text = malloc(e->size+1);
+        if(text==NULL || open_stream(sr, e)){
+                free(text);
+                return 1;
+        }
+        ssize_t len = 0;
+        while((uint64_t)len<e->size){
+                ssize_t r = read_stream(sr, (uint8_t*)text+len, e->size-len);
+                if(r<=0){
+                        break;
+                }
+                len += r;
+        }
+        close_stream(sr);
+        text[len] = 0;
+        int r = parse_metadata(sr, text);
+        free(text);
+        return r;
+}
+
+
+//collect logic chunks: capturefile-1, capturefile-2, ... or single capturefile
+static int find_chunks(sr_file_t *sr){
+        sr->chunks = calloc(sr->entries_n+1, sizeof(sr_entry_t*));
+        if(sr->chunks==NULL){
+                return 1;
+        }
+        char name[SR_NAME_SIZE*2];
+        for(;;){
+                snprintf(name, sizeof(name), "%s-%d", sr->capturefile, sr->chunks_n+1);
+                sr_entry_t *e = find_entry(sr, name);
+                if(e==NULL){
+                        break;
+                }
+                sr->chunks[sr->chunks_n++] = e;
+        }
+        if(sr->chunks_n==0){
+                sr_entry_t *e = find_entry(sr, sr->capturefile);
+                if(e!=NULL){
+                        sr->chunks[sr->chunks_n++] = e;
+                }
+        }
+        if(sr->chunks_n==0){
+                fprintf(stderr, "sr: no logic data in session file\n");
+                return 1;
+        }
+        return 0;
+}
+
+
+//open session file and parse metadata, returns NULL on error
+sr_file_t *sr_open(const char *path){
+        sr_file_t *sr = calloc(1, sizeof(sr_file_t));
+        if(sr==NULL){
+                return NULL;
+        }
+        sr->fd = open(path, O_RDONLY);
+        if(sr->fd<0){
+                fprintf(stderr, "sr: error open %s %s\n", path, strerror(errno));
+                free(sr);
+                return NULL;
+        }
+        struct stat st;
+        if(fstat(sr->fd, &st)!=0){
+                fprintf(stderr, "sr: error stat %s %s\n", path, strerror(errno));
+                sr_close(sr);
+                return NULL;
+        }
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, sr->fd, 0);
+        if(map==MAP_FAILED){
+                fprintf(stderr, "sr: error map %s %s\n", path, strerror(errno));
+                sr_close(sr);
+                return NULL;
+        }
+        sr->map = map;
+        sr->map_size = st.st_size;
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+        if(read_directory(sr)){
+                fprintf(stderr, "sr: %s is not valid zip archive\n", path);
+                sr_close(sr);
+                return NULL;
+        }
+        if(read_metadata(sr) || find_chunks(sr)){
+                sr_close(sr);
+                return NULL;
+        }
+        sr->chunk = -1;
+        return sr;
+}
+
+
+//read up to size bytes of logic data, returns bytes read, 0 on end, -1 on error
+ssize_t sr_read(sr_file_t *sr, uint8_t *buffer, size_t size){
+        size_t total = 0;
+        while(total<size){
+                if(sr->chunk<0 || (sr->data==NULL)){
+                        if(sr->chunk+1>=sr->chunks_n){
+                                break;
+                        }
+                        sr->chunk++;
+                        if(open_stream(sr, sr->chunks[sr->chunk])){
+                                return -1;
+                        }
+                }
+                ssize_t r = read_stream(sr, buffer+total, size-total);
+                if(r<0){
+                        return -1;
+                }
+                if(r==0){
+                        close_stream(sr);
+                        continue;
+                }
+                total += r;
+        }
+        return total;
+}
+
+
+void sr_close(sr_file_t *sr){
+        if(sr==NULL){
+                return;
+        }
+        close_stream(sr);
+        if(sr->map!=NULL){
+                munmap((void*)sr->map, sr->map_size);
+        }
+        if(sr->fd>=0){
+                close(sr->fd);
+        }
+        free(sr->entries);
+        free(sr->chunks);
+        free(sr);
+}
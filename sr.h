@@ -0,0 +1,65 @@
+#ifndef SR_H
+#define SR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+//sigrok session file (.sr) reader
+//.sr is zip archive with 'metadata' ini file and logic data chunks 'logic-1-1', 'logic-1-2', ...
+//(or single 'logic-1' in old files), chunks are inflated directly from mapped archive
+
+#define SR_MAX_PROBES 64
+#define SR_NAME_SIZE 64
+
+//zip archive entry
+typedef struct sr_entry {
+        char name[SR_NAME_SIZE];
+        uint64_t header_offset;//local file header
+        uint64_t compressed_size;
+        uint64_t size;
+        int method;
+} sr_entry_t;
+
+typedef struct sr_file {
+        int fd;
+        const uint8_t *map;
+        size_t map_size;
+
+        sr_entry_t *entries;
+        int entries_n;
+
+        //metadata of first device
+        uint64_t samplerate;//Hz, 0 if unknown
+        int unitsize;
+        int probes_n;
+        char probe_names[SR_MAX_PROBES][SR_NAME_SIZE];
+        char capturefile[SR_NAME_SIZE];
+
+        //logic chunks in stream order
+        sr_entry_t **chunks;
+        int chunks_n;
+
+        //current chunk stream
+        int chunk;
+        const uint8_t *data;//compressed data not yet consumed
+        uint64_t data_left;
+        int method;
+        z_stream zs;
+        bool zs_active;
+} sr_file_t;
+
+
+//file looks like zip archive?
+bool sr_is_session_file(const char *path);
+
+//open session file and parse metadata, returns NULL on error
+sr_file_t *sr_open(const char *path);
+
+//read up to size bytes of logic data, returns bytes read, 0 on end, -1 on error
+ssize_t sr_read(sr_file_t *sr, uint8_t *buffer, size_t size);
+
+void sr_close(sr_file_t *sr);
+
+#endif
@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "store.h"
+#include "varint.h"
+#include "writeat.h"
+#include "sbus.h"
+#include "dshot.h"
+
+
+//create store file, returns NULL on error
+value_store_t *value_store_create(const char *path, uint64_t samplerate, uint32_t probe_mask, const uint8_t *protocols){
+        value_store_t *s = calloc(1, sizeof(value_store_t));
+        if(s==NULL){
+                fprintf(stderr, "error allocate value store\n");
+                return NULL;
+        }
+        s->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(s->fd<0){
+                fprintf(stderr, "error open %s %s\n", path, strerror(errno));
+                free(s);
+                return NULL;
+        }
+        value_store_header_t *h = &s->header;
+        memcpy(h->magic, VALUE_STORE_MAGIC, sizeof(h->magic));
+        h->version = VALUE_STORE_VERSION;
+        h->probe_mask = probe_mask;
+        h->samplerate = samplerate;
+        memcpy(h->protocols, protocols, sizeof(h->protocols));
+        //header without seek table marks file being written
+        s->error = write_at(s->fd, h, sizeof(value_store_header_t), 0);
+        if(s->error){
+                fprintf(stderr, "error write %s %s\n", path, strerror(s->error));
+                close(s->fd);
+                free(s);
+                return NULL;
+        }
+        s->offset = sizeof(value_store_header_t);
+        return s;
+}
+
+
+//append collected block of column to file and seek table
+static void flush_column(value_store_t *s, value_store_column_t *col){
+        if(s->blocks_n>=s->blocks_capacity){
+                uint32_t capacity = s->blocks_capacity ? s->blocks_capacity*2 : 1024;
+                value_store_block_t *blocks = realloc(s->blocks, capacity*sizeof(value_store_block_t));
+                if(blocks==NULL){
+                        s->error = ENOMEM;
+                } else {
+                        s->blocks = blocks;
+                        s->blocks_capacity = capacity;
+                }
+        }
+        if(!s->error){
+                col->block.offset = s->offset+sizeof(value_store_block_t);
+                int error = write_at(s->fd, &col->block, sizeof(value_store_block_t), s->offset);
+                if(!error){
+                        error = write_at(s->fd, col->buffer, col->block.size, col->block.offset);
+                }
+                s->error = error;
+                s->offset = col->block.offset+col->block.size;
+                s->blocks[s->blocks_n++] = col->block;
+        }
+        col->block.count = 0;
+        col->block.size = 0;
+}
+
+
+//append value of probe column, values of every column must come in time order
+void value_store_add(value_store_t *s, int probe_idx, int column, int64_t time, int32_t value){
+        value_store_column_t *col = &s->columns[probe_idx][column];
+        value_store_block_t *b = &col->block;
+        if(col->buffer==NULL){
+                if(s->error){
+                        return;
+                }
+                col->buffer = malloc(VALUE_STORE_BLOCK_SIZE);
+                if(col->buffer==NULL){
+                        s->error = ENOMEM;
+                        return;
+                }
+                b->probe = probe_idx;
+                b->column = column;
+        }
+        if(b->count==0){
+                //deltas of block start from first time and zero value
+                b->first_time = time;
+                b->last_time = time;
+                b->min = value;
+                b->max = value;
+                b->sum = 0;
+                b->sum_squares = 0;
+                col->last_value = 0;
+        }
+        uint8_t *p = put_varint(col->buffer+b->size, time-b->last_time);
+        p = put_varint(p, zigzag_encode((int64_t)value-col->last_value));
+        b->size = p-col->buffer;
+        b->last_time = time;
+        b->count++;
+        b->sum += value;
+        b->sum_squares += (double)value*value;
+        if(value<b->min){
+                b->min = value;
+        }
+        if(value>b->max){
+                b->max = value;
+        }
+        col->last_value = value;
+        s->header.values++;
+        if(b->count>=VALUE_STORE_BLOCK_VALUES){
+                flush_column(s, col);
+        }
+}
+
+
+//append values of decoded event: pulse width and period, sbus channels and flags, dshot value
+void value_store_add_event(value_store_t *s, event_buffer_t *buf, dump_event_t *event){
+        switch(event->type){
+        case EVENT_PULSE:
+                value_store_add(s, event->probe, VALUE_COLUMN_WIDTH, event->time, event->pulse.width);
+                value_store_add(s, event->probe, VALUE_COLUMN_PERIOD, event->time, event->pulse.period);
+                break;
+        case EVENT_SBUS_PACKET: {
+                sbus_frame_t frame;
+                if(sbus_unpack(buf->data+event->sbus.offset, event->sbus.length, &frame)){
+                        s->bad_frames++;
+                        break;
+                }
+                for(int i=0;i<SBUS_CHANNELS;i++){
+                        value_store_add(s, event->probe, i, event->time, frame.channels[i]);
+                }
+                int flags = (frame.ch17 ? SBUS_FLAG_CH17 : 0) | (frame.ch18 ? SBUS_FLAG_CH18 : 0) |
+                        (frame.lost ? SBUS_FLAG_LOST : 0) | (frame.failsafe ? SBUS_FLAG_FAILSAFE : 0);
+                value_store_add(s, event->probe, VALUE_COLUMN_SBUS_FLAGS, event->time, flags);
+                break;
+        }
+        case EVENT_DSHOT_FRAME: {
+                dshot_frame_t frame;
+                if(dshot_unpack(event->dshot.bits, &frame)){
+                        s->bad_frames++;
+                        break;
+                }
+                value_store_add(s, event->probe, VALUE_COLUMN_DSHOT, event->time, frame.throttle);
+                break;
+        }
+        }
+}
+
+
+//flush blocks, write seek table and header, returns 0 on success
+int value_store_close(value_store_t *s){
+        for(int i=0;i<VALUE_STORE_PROBES;i++){
+                for(int c=0;c<VALUE_STORE_COLUMNS;c++){
+                        if(s->columns[i][c].block.count>0){
+                                flush_column(s, &s->columns[i][c]);
+                        }
+                        free(s->columns[i][c].buffer);
+                }
+        }
+        s->header.blocks = s->blocks_n;
+        s->header.seek_offset = s->offset;
+        if(!s->error){
+                s->error = write_at(s->fd, s->blocks, (size_t)s->blocks_n*sizeof(value_store_block_t), s->offset);
+        }
+        if(!s->error){
+                s->error = write_at(s->fd, &s->header, sizeof(value_store_header_t), 0);
+        }
+        if(close(s->fd)!=0 && !s->error){
+                s->error = errno;
+        }
+        int error = s->error;
+        if(error){
+                fprintf(stderr, "error write value store %s\n", strerror(error));
+        }
+        free(s->blocks);
+        free(s);
+        return error!=0;
+}
+
+
+//block header is consistent with file
+static bool block_valid(const value_store_reader_t *r, const value_store_block_t *b){
+        return b->probe<VALUE_STORE_PROBES && b->column<VALUE_STORE_COLUMNS && b->count<=VALUE_STORE_BLOCK_VALUES &&
+                b->offset<=r->map_size && r->map_size-b->offset>=b->size;
+}
+
+
+//rebuild seek table of file which was not closed from block headers
+static int recover_blocks(value_store_reader_t *r){
+        uint32_t capacity = 0;
+        uint64_t pos = sizeof(value_store_header_t);
+        while(r->map_size-pos>=sizeof(value_store_block_t)){
+                value_store_block_t b;
+                memcpy(&b, r->map+pos, sizeof(b));
+                if(b.offset!=pos+sizeof(b) || !block_valid(r, &b)){
+                        break;
+                }
+                if(r->blocks>=capacity){
+                        capacity = capacity ? capacity*2 : 1024;
+                        value_store_block_t *blocks = realloc(r->seek, capacity*sizeof(value_store_block_t));
+                        if(blocks==NULL){
+                                fprintf(stderr, "error allocate value store\n");
+                                return 1;
+                        }
+                        r->seek = blocks;
+                }
+                r->seek[r->blocks++] = b;
+                r->header.values += b.count;
+                pos = b.offset+b.size;
+        }
+        return 0;
+}
+
+
+//open store file, returns 0 on success
+int value_store_open(value_store_reader_t *r, const char *path){
+        memset(r, 0, sizeof(value_store_reader_t));
+        r->fd = open(path, O_RDONLY);
+        if(r->fd<0){
+                fprintf(stderr, "error open %s %s\n", path, strerror(errno));
+                return 1;
+        }
+        struct stat st;
+        if(fstat(r->fd, &st)!=0 || (size_t)st.st_size<sizeof(value_store_header_t)){
+                fprintf(stderr, "error read value store %s\n", path);
+                value_store_close_reader(r);
+                return 1;
+        }
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+        if(map==MAP_FAILED){
+                fprintf(stderr, "error map %s %s\n", path, strerror(errno));
+                value_store_close_reader(r);
+                return 1;
+        }
+        r->map = map;
+        r->map_size = st.st_size;
+        memcpy(&r->header, r->map, sizeof(value_store_header_t));
+        value_store_header_t *h = &r->header;
+        if(memcmp(h->magic, VALUE_STORE_MAGIC, sizeof(h->magic))!=0 || h->version!=VALUE_STORE_VERSION){
+                fprintf(stderr, "%s is not value store\n", path);
+                value_store_close_reader(r);
+                return 1;
+        }
+        if(h->seek_offset==0){
+                fprintf(stderr, "value store %s was not closed, reading complete blocks\n", path);
+                if(recover_blocks(r)){
+                        value_store_close_reader(r);
+                        return 1;
+                }
+                return 0;
+        }
+        if(h->seek_offset>r->map_size || (r->map_size-h->seek_offset)/sizeof(value_store_block_t)<h->blocks){
+                fprintf(stderr, "value store %s is truncated\n", path);
+                value_store_close_reader(r);
+                return 1;
+        }
+        //seek table follows varint payloads, so it is not aligned in file, +1 keeps empty table allocated
+        r->seek = malloc((size_t)h->blocks*sizeof(value_store_block_t)+1);
+        if(r->seek==NULL){
+                fprintf(stderr, "error allocate value store\n");
+                value_store_close_reader(r);
+                return 1;
+        }
+        memcpy(r->seek, r->map+h->seek_offset, (size_t)h->blocks*sizeof(value_store_block_t));
+        r->blocks = h->blocks;
+        for(uint32_t i=0;i<r->blocks;i++){
+                if(!block_valid(r, &r->seek[i])){
+                        fprintf(stderr, "value store %s is corrupted\n", path);
+                        value_store_close_reader(r);
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+
+//decode values of block, times and values hold VALUE_STORE_BLOCK_VALUES entries, returns number of values
+int value_store_read_block(value_store_reader_t *r, const value_store_block_t *block, int64_t *times, int32_t *values){
+        const uint8_t *p = r->map+block->offset;
+        const uint8_t *end = p+block->size;
+        int64_t time = block->first_time;
+        int64_t value = 0;
+        uint32_t n = 0;
+        while(n<block->count && p<end){
+                uint64_t delta;
+                p = get_varint(p, &delta);
+                time += delta;
+                p = get_varint(p, &delta);
+                value += zigzag_decode(delta);
+                times[n] = time;
+                values[n] = value;
+                n++;
+        }
+        return n;
+}
+
+
+void value_store_close_reader(value_store_reader_t *r){
+        if(r->map!=NULL){
+                munmap((void *)r->map, r->map_size);
+        }
+        if(r->fd>=0){
+                close(r->fd);
+        }
+        free(r->seek);
+        memset(r, 0, sizeof(value_store_reader_t));
+        r->fd = -1;
+}
+
+
+//column name of protocol, e.g. width, ch5, flags, NULL if column is not used by protocol
+const char *value_column_name(int protocol, int column){
+        static const char *sbus_names[VALUE_STORE_COLUMNS] = {
+                "ch1", "ch2", "ch3", "ch4", "ch5", "ch6", "ch7", "ch8",
+                "ch9", "ch10", "ch11", "ch12", "ch13", "ch14", "ch15", "ch16", "flags",
+        };
+        switch(protocol){
+        case PROTOCOL_PWM:
+                return column==VALUE_COLUMN_WIDTH ? "width" : column==VALUE_COLUMN_PERIOD ? "period" : NULL;
+        case PROTOCOL_SBUS:
+                return column>=0 && column<VALUE_STORE_COLUMNS ? sbus_names[column] : NULL;
+        case PROTOCOL_DSHOT:
+                return column==VALUE_COLUMN_DSHOT ? "value" : NULL;
+        }
+        return NULL;
+}
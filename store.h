@@ -0,0 +1,121 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "eventlog.h"
+
+//columnar store of decoded values (pwm -V) for post-session analysis, queried by pwmquery
+//column is one value kind of probe: pwm width or period, sbus channel or flags, dshot value
+//file: header, blocks of one column (block header + payload), seek table of all blocks
+//payload is varint time delta and zigzag varint value delta of every value
+//block header keeps time range, count, min, max, sum and sum of squares, so queries skip blocks
+//out of time range and aggregate whole blocks without decoding them
+//blocks are only appended, seek table and final header are written on close, blocks of file
+//which was not closed are found by walking block headers
+//all fields are little-endian
+#define VALUE_STORE_MAGIC "PWMVSTOR"
+#define VALUE_STORE_VERSION 1
+#define VALUE_STORE_PROBES 32
+#define VALUE_STORE_BLOCK_VALUES 4096
+//varint of 64-bit time delta takes at most 10 bytes, zigzag of 32-bit value delta 5 bytes
+#define VALUE_STORE_BLOCK_SIZE (VALUE_STORE_BLOCK_VALUES*15)
+
+//columns of pwm probe, in samples
+#define VALUE_COLUMN_WIDTH 0
+#define VALUE_COLUMN_PERIOD 1
+//columns of sbus probe: channels 1-16 are columns 0-15, then ch17, ch18, lost and failsafe bits as in frame flags
+#define VALUE_COLUMN_SBUS_FLAGS 16
+//column of dshot probe: 11 bit throttle or command of frames with valid crc
+#define VALUE_COLUMN_DSHOT 0
+#define VALUE_STORE_COLUMNS 17
+
+typedef struct value_store_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t probe_mask;
+        uint64_t samplerate;//Hz
+        uint64_t values;
+        uint32_t blocks;//seek table entries, 0 if file was not closed
+        uint32_t reserved;
+        uint64_t seek_offset;//seek table position
+        uint8_t protocols[32];//PROTOCOL_* of every probe, PROTOCOL_OFF if not decoded
+} value_store_header_t;
+
+//block header in file, same data is kept in seek table
+typedef struct value_store_block {
+        uint8_t probe;
+        uint8_t column;
+        uint16_t reserved;
+        uint32_t count;
+        uint32_t size;//varint payload bytes
+        int32_t min;
+        int32_t max;
+        uint32_t reserved2;
+        int64_t sum;
+        double sum_squares;
+        int64_t first_time;
+        int64_t last_time;
+        uint64_t offset;//payload position in file
+} value_store_block_t;
+
+_Static_assert(sizeof(value_store_header_t)==80, "value store header size");
+_Static_assert(sizeof(value_store_block_t)==64, "value store block size");
+
+//column block being collected, buffer is allocated on first value
+typedef struct value_store_column {
+        uint8_t *buffer;
+        value_store_block_t block;
+        int32_t last_value;
+} value_store_column_t;
+
+//store writer, fed by output stage only
+typedef struct value_store {
+        int fd;
+        value_store_header_t header;
+        value_store_column_t columns[VALUE_STORE_PROBES][VALUE_STORE_COLUMNS];
+        uint64_t offset;//file end
+        value_store_block_t *blocks;
+        uint32_t blocks_n;
+        uint32_t blocks_capacity;
+        long long bad_frames;//sbus packets and dshot frames without values
+        int error;//errno of failed write
+} value_store_t;
+
+//memory mapped store reader
+typedef struct value_store_reader {
+        int fd;
+        const uint8_t *map;
+        size_t map_size;
+        value_store_header_t header;
+        value_store_block_t *seek;//copy of seek table, rebuilt from block headers if file was not closed
+        uint32_t blocks;
+} value_store_reader_t;
+
+
+//create store file, returns NULL on error
+value_store_t *value_store_create(const char *path, uint64_t samplerate, uint32_t probe_mask, const uint8_t *protocols);
+
+//append value of probe column, values of every column must come in time order
+void value_store_add(value_store_t *s, int probe_idx, int column, int64_t time, int32_t value);
+
+//append values of decoded event: pulse width and period, sbus channels and flags, dshot value
+void value_store_add_event(value_store_t *s, event_buffer_t *buf, dump_event_t *event);
+
+//flush blocks, write seek table and header, returns 0 on success
+int value_store_close(value_store_t *s);
+
+
+//open store file, returns 0 on success
+int value_store_open(value_store_reader_t *r, const char *path);
+
+//decode values of block, times and values hold VALUE_STORE_BLOCK_VALUES entries, returns number of values
+int value_store_read_block(value_store_reader_t *r, const value_store_block_t *block, int64_t *times, int32_t *values);
+
+void value_store_close_reader(value_store_reader_t *r);
+
+//column name of protocol, e.g. width, ch5, flags, NULL if column is not used by protocol
+const char *value_column_name(int protocol, int column);
+
+#endif
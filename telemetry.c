@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "pwm.h"
+#include "telemetry.h"
+
+
+//create segment and write header, returns NULL on error
+telemetry_writer_t *telemetry_open(const char *name, uint64_t samplerate, uint32_t probe_mask){
+        telemetry_writer_t *w = calloc(1, sizeof(telemetry_writer_t));
+        if(w==NULL){
+                fprintf(stderr, "error allocate telemetry\n");
+                return NULL;
+        }
+        //shm names start with single slash
+        snprintf(w->name, sizeof(w->name), "%s%s", name[0]=='/' ? "" : "/", name);
+        int fd = shm_open(w->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd<0){
+                fprintf(stderr, "error open shared memory %s %s\n", w->name, strerror(errno));
+                free(w);
+                return NULL;
+        }
+        if(ftruncate(fd, sizeof(telemetry_t))!=0){
+                fprintf(stderr, "error size shared memory %s %s\n", w->name, strerror(errno));
+                close(fd);
+                shm_unlink(w->name);
+                free(w);
+                return NULL;
+        }
+        void *map = mmap(NULL, sizeof(telemetry_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(map==MAP_FAILED){
+                fprintf(stderr, "error map shared memory %s %s\n", w->name, strerror(errno));
+                shm_unlink(w->name);
+                free(w);
+                return NULL;
+        }
+        w->shm = map;
+
+        //new segment is zero filled, magic is written last so readers never see partial header
+        telemetry_header_t *h = &w->shm->header;
+        h->version = TELEMETRY_VERSION;
+        h->size = sizeof(telemetry_t);
+        h->probe_size = sizeof(telemetry_probe_t);
+        h->probes = TELEMETRY_PROBES;
+        h->probe_mask = probe_mask;
+        h->samplerate = samplerate;
+        for(int i=0;i<TELEMETRY_PROBES;i++){
+                w->shm->probes[i].protocol = PROTOCOL_OFF;
+        }
+        h->state = TELEMETRY_RUNNING;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(h->magic, TELEMETRY_MAGIC, sizeof(h->magic));
+        return w;
+}
+
+
+static void fill_probe(telemetry_probe_t *t, probe_data_t *probe){
+        t->protocol = probe->protocol;
+        t->pulses = probe->pulse_count;
+
+        average_data_t *width = &probe->pulse_width_avg;
+        average_data_t *period = &probe->period_avg;
+        t->width = width->last_value;
+        t->width_median = width->median;
+        t->width_average = width->average;
+        t->width_rmsd = width->rmsd;
+        t->period = period->last_value;
+        t->period_median = period->median;
+        t->period_average = period->average;
+        t->period_rmsd = period->rmsd;
+
+        sbus_stats_t *sbus = &probe->sbus_stats;
+        t->sbus_bytes = probe->sbus_bytes;
+        t->sbus_errors = probe->sbus_errors;
+        t->sbus_parity_errors = probe->parity_errors;
+        t->sbus_frames = sbus->frames;
+        t->sbus_bad_frames = sbus->bad_frames;
+        t->sbus_lost_frames = sbus->lost_frames;
+        t->sbus_failsafe_frames = sbus->failsafe_frames;
+        for(int c=0;c<TELEMETRY_CHANNELS;c++){
+                t->channels[c] = sbus->last.channels[c];
+        }
+        t->ch17 = sbus->last.ch17;
+        t->ch18 = sbus->last.ch18;
+        t->lost = sbus->last.lost;
+        t->failsafe = sbus->last.failsafe;
+        t->sbus_interval = sbus->interval.average;
+
+        dshot_stats_t *dshot = &probe->dshot_stats;
+        t->dshot_frames = dshot->frames;
+        t->dshot_crc_errors = dshot->crc_errors;
+        t->dshot_bit_errors = dshot->bit_errors;
+        t->throttle = dshot->last.throttle;
+        t->telemetry = dshot->last.telemetry;
+        t->dshot_interval = dshot->interval.average;
+}
+
+
+//publish decoded state of context
+void telemetry_publish(telemetry_writer_t *w, context_t *ctx){
+        telemetry_t *shm = w->shm;
+        telemetry_header_t *h = &shm->header;
+        uint64_t seq = h->seq;
+        __atomic_store_n(&h->seq, seq+1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        h->updates++;
+        h->samples = ctx->line_num-1;
+        h->edges = ctx->edges_n;
+        h->frames = count_frames(ctx->probes, ctx->probes_n);
+        for(int i=0;i<ctx->probes_n;i++){
+                if(ctx->probe_mask & (1U<<i)){
+                        fill_probe(&shm->probes[i], &ctx->probes[i]);
+                }
+        }
+
+        __atomic_store_n(&h->seq, seq+2, __ATOMIC_RELEASE);
+}
+
+
+//mark segment stopped, unmap and unlink it
+//readers which mapped segment keep last state
+void telemetry_close(telemetry_writer_t *w){
+        if(w==NULL){
+                return;
+        }
+        __atomic_store_n(&w->shm->header.state, TELEMETRY_STOPPED, __ATOMIC_RELEASE);
+        munmap(w->shm, sizeof(telemetry_t));
+        shm_unlink(w->name);
+        free(w);
+}
@@ -0,0 +1,121 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <string.h>
+
+//live decoder state in POSIX shared memory (shm_open name given to pwm -M), for external monitors
+//segment is one telemetry_t: header, then TELEMETRY_PROBES probe records, native byte order
+//writer is single decode/output thread, readers map segment read-only and never block writer
+//updates are protected by seqlock: seq is odd while writer updates, readers copy the segment
+//and retry if seq was odd or changed during copy (see telemetry_read), so no syscalls are needed
+//layout only grows at the end of records, version changes on incompatible change;
+//readers check magic, version and sizes
+//times and durations are in samples, divide by samplerate
+//per-probe counters are low 32 bits of decoder counters and wrap on long runs, use differences
+#define TELEMETRY_MAGIC "PWMTELEM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PROBES 32
+#define TELEMETRY_CHANNELS 16
+
+//header state
+#define TELEMETRY_STOPPED 0
+#define TELEMETRY_RUNNING 1
+
+typedef struct telemetry_probe {
+        uint32_t protocol;//PROTOCOL_* of eventlog.h, 0xFF if probe is not decoded
+        uint32_t pulses;
+
+        //pwm, last value and window statistics of pulse width and period
+        int32_t width;
+        int32_t width_median;
+        double width_average;
+        double width_rmsd;
+        int32_t period;
+        int32_t period_median;
+        double period_average;
+        double period_rmsd;
+
+        //sbus
+        uint32_t sbus_bytes;
+        uint32_t sbus_errors;//start bit errors
+        uint32_t sbus_parity_errors;
+        uint32_t sbus_frames;
+        uint32_t sbus_bad_frames;
+        uint32_t sbus_lost_frames;
+        uint32_t sbus_failsafe_frames;
+        uint16_t channels[TELEMETRY_CHANNELS];//last valid frame
+        uint8_t ch17;
+        uint8_t ch18;
+        uint8_t lost;
+        uint8_t failsafe;
+        double sbus_interval;//average samples between valid frames
+
+        //dshot
+        uint32_t dshot_frames;
+        uint32_t dshot_crc_errors;
+        uint32_t dshot_bit_errors;
+        uint16_t throttle;//last valid frame
+        uint8_t telemetry;
+        uint8_t reserved_dshot;
+        double dshot_interval;//average samples between valid frames
+} telemetry_probe_t;
+
+typedef struct telemetry_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t size;//sizeof(telemetry_t)
+        uint32_t probe_size;//sizeof(telemetry_probe_t)
+        uint32_t probes;//TELEMETRY_PROBES
+        uint32_t probe_mask;//decoded probes
+        uint32_t state;//TELEMETRY_RUNNING while pwm runs
+        uint64_t samplerate;//Hz
+        uint64_t seq;//seqlock sequence, odd during update
+        uint64_t updates;
+        uint64_t samples;//decoded samples, time of state
+        uint64_t edges;
+        uint64_t frames;
+} telemetry_header_t;
+
+typedef struct telemetry {
+        telemetry_header_t header;
+        telemetry_probe_t probes[TELEMETRY_PROBES];
+} telemetry_t;
+
+_Static_assert(sizeof(telemetry_probe_t)==152, "telemetry probe size");
+_Static_assert(sizeof(telemetry_header_t)==80, "telemetry header size");
+
+
+//consistent copy of shared segment, for readers
+static inline void telemetry_read(const telemetry_t *shm, telemetry_t *copy){
+        for(;;){
+                uint64_t seq = __atomic_load_n(&shm->header.seq, __ATOMIC_ACQUIRE);
+                if(seq & 1){
+                        continue;
+                }
+                memcpy(copy, (const void *)shm, sizeof(telemetry_t));
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if(__atomic_load_n(&shm->header.seq, __ATOMIC_RELAXED)==seq){
+                        return;
+                }
+        }
+}
+
+
+//writer side, pwm only
+struct context;
+typedef struct telemetry_writer {
+        char name[256];
+        telemetry_t *shm;
+} telemetry_writer_t;
+
+//create segment and write header, returns NULL on error
+telemetry_writer_t *telemetry_open(const char *name, uint64_t samplerate, uint32_t probe_mask);
+
+//publish decoded state of context
+void telemetry_publish(telemetry_writer_t *w, struct context *ctx);
+
+//mark segment stopped, unmap and unlink it
+void telemetry_close(telemetry_writer_t *w);
+
+#endif
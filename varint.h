@@ -0,0 +1,42 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <stdint.h>
+
+//little-endian base 128 varints of edge index and value store
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t value){
+        while(value>=0x80){
+                *p++ = value | 0x80;
+                value >>= 7;
+        }
+        *p++ = value;
+        return p;
+}
+
+
+static inline const uint8_t *get_varint(const uint8_t *p, uint64_t *value){
+        uint64_t v = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+                b = *p++;
+                v |= (uint64_t)(b & 0x7F)<<shift;
+                shift += 7;
+        } while((b & 0x80) && shift<64);
+        *value = v;
+        return p;
+}
+
+
+//signed delta as small unsigned number: 0, -1, 1, -2, ... are 0, 1, 2, 3, ...
+static inline uint64_t zigzag_encode(int64_t value){
+        return ((uint64_t)value<<1) ^ (uint64_t)(value>>63);
+}
+
+
+static inline int64_t zigzag_decode(uint64_t value){
+        return (int64_t)(value>>1) ^ -(int64_t)(value & 1);
+}
+
+#endif
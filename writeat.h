@@ -0,0 +1,29 @@
+#ifndef WRITEAT_H
+#define WRITEAT_H
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <unistd.h>
+
+//positioned writes of edge index and value store
+
+//write whole buffer at offset, returns 0 or errno
+static inline int write_at(int fd, const void *data, size_t size, uint64_t offset){
+        const uint8_t *p = data;
+        while(size>0){
+                ssize_t r = pwrite(fd, p, size, offset);
+                if(r<0){
+                        if(errno==EINTR){
+                                continue;
+                        }
+                        return errno;
+                }
+                p += r;
+                size -= r;
+                offset += r;
+        }
+        return 0;
+}
+
+#endif